@@ -1,10 +1,17 @@
 #include <Arduino.h>
 #include "aidassert.h"
+#include "failsafe.h"
 
 #ifndef NDEBUG
 
 void assertionFailure(const __FlashStringHelper *cond, const __FlashStringHelper *file, int line) {
-  if (Serial) {
+  // Make everything safe before taking the time to print.  With
+  // interrupts off, Serial waits for each byte to go out.
+  noInterrupts();
+  emergencyKill();
+  // Printing while the laser has the USART would garble the pattern
+  // (see usartlaser.h).
+  if (Serial && !(UCSR0C & (1 << UMSEL00))) {
     Serial.print(file);
     Serial.print('(');
     Serial.print(line);
@@ -12,8 +19,9 @@ void assertionFailure(const __FlashStringHelper *cond, const __FlashStringHelper
     Serial.print(F("assertion failure: `"));
     Serial.print(cond);
     Serial.println('`');
+    Serial.flush();
   }
-  for (;;) { delay(1000); }
+  assertionReset(line);
 }
 
 #endif
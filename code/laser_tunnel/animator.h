@@ -2,94 +2,334 @@
 #define ANIMATOR_H
 
 #include <Arduino.h>
+#include "audioinput.h"
 #include "patternbuffer.h"
+#include "polar.h"
+#include "framestream.h"
+#include "rng.h"
+#include "script.h"
+#include "scriptloader.h"
+#include "sequence.h"
+#include "sequences.h"
+#include "textscroller.h"
+#include "transition.h"
 
-typedef void (*Animation)(PatternBuffer &pattern, unsigned frame);
+// Animations that need to remember something from one frame to the
+// next keep it in an AnimationState rather than in static variables, so
+// that two animations can run at once during a transition without
+// stepping on each other.  Each animation uses at most one member and
+// initializes it on frame 0.
+//
+// The Compositor (for Layered) and the ScriptVM (for Scripted) are too
+// big to keep two of, so those animations still use a single static
+// instance.  That's safe because the Animator never runs two copies of
+// the same animation:  `transitionTo` cuts instead.
+union AnimationState {
+  AnimationState() : glitch() {}
+
+  struct { unsigned glitch_frame, restore_frame; } glitch;
+  uint8_t seeds[4];
+  uint8_t phase;
+  SequencePlayer sequence;
+  TextScroller scroller;
+};
+
+typedef void (*Animation)(PatternBuffer &pattern, unsigned frame, AnimationState &state);
 
 class Animator {
   public:
-    Animator() : m_frame(0), m_animation(nullptr) {}
+    Animator() :
+      m_frame(0), m_skew(0), m_animation(nullptr), m_state(),
+      m_outgoing(nullptr), m_outgoing_frame(0), m_outgoing_state(),
+      m_from(), m_to(), m_transition(TRANSITION_CUT), m_step(0), m_length(0) {}
 
+    // Switches to `animation` immediately.
     void setAnimation(Animation animation) {
       m_frame = 0;
+      m_skew = 0;
+      m_animation = animation;
+      m_outgoing = nullptr;
+    }
+
+    // Switches to `animation` over `length` revolutions.  The outgoing
+    // animation picks up from what's now in `pattern` and keeps running
+    // until the transition is complete.
+    void transitionTo(
+      Animation animation, const PatternBuffer &pattern,
+      Transition transition, uint8_t length
+    ) {
+      // Blending an animation with itself (even one that's on its way
+      // out) would mean two copies sharing any static state.
+      if (m_animation == nullptr || animation == m_animation ||
+          animation == m_outgoing ||
+          transition == TRANSITION_CUT || length == 0) {
+        return setAnimation(animation);
+      }
+      if (m_outgoing == nullptr) {
+        m_outgoing = m_animation;
+        m_outgoing_frame = m_frame;
+        m_outgoing_state = m_state;
+        m_from.copy(pattern);
+      }
+      // Otherwise a transition is already underway, and the animation
+      // coming in is simply replaced.
+      m_to.clear();
+      m_to.setRotation(0);
+      m_frame = 0;
+      m_skew = 0;
       m_animation = animation;
+      m_transition = transition;
+      m_step = 0;
+      m_length = length;
     }
 
-    void update(volatile bool &rev_flag, PatternBuffer &pattern) {
-      if (m_animation == nullptr) return;
+    // The incoming animation, during a transition.
+    Animation animation() const { return m_animation; }
+    bool transitioning() const { return m_outgoing != nullptr; }
+
+    // The number of the next frame to render.
+    unsigned frame() const { return m_frame; }
+
+    // Asks the animator to get `delta` frames ahead (or behind, if
+    // negative).  Rather than skipping frames, which would confuse
+    // animations that wait for a particular frame, it catches up by
+    // rendering two frames in one revolution, or it falls back by
+    // holding a frame for an extra revolution.
+    void nudge(int delta) { m_skew = delta; }
+
+    // Returns true if it rendered a frame.
+    bool update(volatile bool &rev_flag, PatternBuffer &pattern) {
+      if (m_animation == nullptr) return false;
       noInterrupts();
       const bool need_frame = rev_flag;
       rev_flag = false;
       interrupts();
-      if (need_frame) (*m_animation)(pattern, m_frame++);
+      if (!need_frame) return false;
+      if (m_skew < 0) {
+        ++m_skew;
+        return false;
+      }
+      if (m_skew > 0) {
+        --m_skew;
+        render(pattern);
+      }
+      render(pattern);
+      return true;
     }
     
   private:
+    void render(PatternBuffer &pattern) {
+      if (m_outgoing == nullptr) {
+        (*m_animation)(pattern, m_frame++, m_state);
+        return;
+      }
+      (*m_outgoing)(m_from, m_outgoing_frame++, m_outgoing_state);
+      (*m_animation)(m_to, m_frame++, m_state);
+      if (++m_step < m_length) {
+        pattern.setRotation(0);
+        blendTransition(pattern, m_from, m_to, m_transition, m_step, m_length);
+        return;
+      }
+      // Hand the pattern over to the incoming animation.
+      pattern.copy(m_to);
+      m_outgoing = nullptr;
+    }
+
     unsigned m_frame;
+    int m_skew;
     Animation m_animation;
+    AnimationState m_state;
+
+    // During a transition, the outgoing animation and both animations'
+    // buffers.
+    Animation m_outgoing;
+    unsigned m_outgoing_frame;
+    AnimationState m_outgoing_state;
+    PatternBuffer m_from;
+    PatternBuffer m_to;
+    Transition m_transition;
+    uint8_t m_step;
+    uint8_t m_length;
 };
 
-void Glitch(PatternBuffer &pattern, unsigned frame) {
-  static unsigned glitch_frame = 0;
-  static unsigned restore_frame = 0;
+// A Compositor runs several animations at once, each drawing into
+// its own layer, and combines the layers into the output buffer once
+// per revolution.  Each layer costs a PatternBuffer's worth of RAM,
+// plus its own AnimationState.
+struct Layer {
+  Animation animation;
+  PatternBuffer::Blend blend;
+};
+
+template <uint8_t N>
+class Compositor {
+  public:
+    explicit Compositor(const Layer (&layers)[N]) :
+      m_layers(layers), m_buffers(), m_states() {}
+
+    void render(PatternBuffer &output, unsigned frame) {
+      if (frame == 0) {
+        // Start each layer fresh so that the result doesn't depend
+        // on what ran before.
+        output.setRotation(0);
+        for (auto &buffer : m_buffers) {
+          buffer.clear();
+          buffer.setRotation(0);
+        }
+      }
+      for (uint8_t i = 0; i < N; ++i) {
+        (*m_layers[i].animation)(m_buffers[i], frame, m_states[i]);
+      }
+      // Build each output byte completely before storing it so that
+      // the pixel ISR never sees a partially combined byte.
+      for (uint8_t k = 0; k < output.size() / 8; ++k) {
+        uint8_t pixels = 0;
+        for (uint8_t i = 0; i < N; ++i) {
+          pixels = PatternBuffer::blend(
+            pixels, m_buffers[i].displayedByte(k), m_layers[i].blend);
+        }
+        output.setByte(k, pixels);
+      }
+    }
+
+  private:
+    const Layer *m_layers;
+    PatternBuffer m_buffers[N];
+    AnimationState m_states[N];
+};
+
+void Glitch(PatternBuffer &pattern, unsigned frame, AnimationState &state) {
+  auto &glitch_frame = state.glitch.glitch_frame;
+  auto &restore_frame = state.glitch.restore_frame;
 
   if (frame == 0) {
     pattern.setTestPattern();
+    glitch_frame = 0;
     restore_frame = 0;
   }
 
   if (frame == restore_frame) {
     pattern.setRotation(0);
-    glitch_frame = frame + random(10, 90);
+    glitch_frame = frame + rng.between(10, 90);
   } else if (frame == glitch_frame) {
-    pattern.setRotation(10*random(-10, 10));
-    restore_frame = frame + random(3, 25);
+    pattern.setRotation(10*rng.between(-10, 10));
+    restore_frame = frame + rng.between(3, 25);
   }
 }
 
 
-void RadialSeeds(PatternBuffer &pattern, unsigned frame) {
-  static uint8_t m_seeds[4];
-
+void RadialSeeds(PatternBuffer &pattern, unsigned frame, AnimationState &state) {
   if (frame == 0) {
     pattern.clear();
-    for (auto &s : m_seeds) s = random(256);
+    for (auto &s : state.seeds) s = rng.below(256);
   }
 
   for (int i = 0; i < 4; ++i) {
-    const auto seed = m_seeds[i];
+    const auto seed = state.seeds[i];
     const auto offset = (i+1)*frame/8;
     pattern.setPixel(seed + offset);
     pattern.setPixel(seed - offset);
   }
 }
 
-void RotaryCorruption(PatternBuffer &pattern, unsigned /*frame*/) {
+void RotaryCorruption(PatternBuffer &pattern, unsigned /*frame*/, AnimationState &) {
   pattern.rotate(-1);
-  pattern.togglePixel(random(pattern.size()));
+  pattern.togglePixel(rng.below(pattern.size()));
 }
 
-void WaxOn(PatternBuffer &pattern, unsigned frame) {
+void WaxOn(PatternBuffer &pattern, unsigned frame, AnimationState &) {
   if (frame == 0) {
     pattern.clear();
     pattern.setRotation(0);
     return;
   }
-  pattern.setPixel(2*frame);
-  pattern.setPixel(2*frame+1);
+  pattern.setRange(2*frame, 2);
 }
 
-void WaxOff(PatternBuffer &pattern, unsigned frame) {
-  pattern.clearPixel(255 - (2*frame));
-  pattern.clearPixel(255 - (2*frame+1));
+void WaxOff(PatternBuffer &pattern, unsigned frame, AnimationState &) {
+  pattern.clearRange(255 - (2*frame+1), 2);
 }
 
 
-void Composite(PatternBuffer &pattern, unsigned frame) {
+void Composite(PatternBuffer &pattern, unsigned frame, AnimationState &state) {
   frame = frame % 628;
-  if (frame <= 128) return WaxOn(pattern, frame);
-  if (frame <= 500) return RotaryCorruption(pattern, frame);
-  if (frame <= 628) return WaxOff(pattern, frame);
+  if (frame <= 128) return WaxOn(pattern, frame, state);
+  if (frame <= 500) return RotaryCorruption(pattern, frame, state);
+  if (frame <= 628) return WaxOff(pattern, frame, state);
+}
+
+void Spokes(PatternBuffer &pattern, unsigned frame, AnimationState &state) {
+  if (frame == 0) state.sequence = SequencePlayer(spokes_sequence);
+  state.sequence.render(pattern, frame);
+}
+
+// Runs the script stored in EEPROM (see scriptloader.h), or the
+// scripted version of Composite if there isn't one.
+void Scripted(PatternBuffer &pattern, unsigned frame, AnimationState &) {
+  static ScriptVM vm(composite_script, sizeof(composite_script), ScriptVM::IN_FLASH);
+  if (frame == 0) {
+    const auto length = ScriptLoader::storedLength();
+    if (length != 0) {
+      vm.load(ScriptLoader::storedScript(), length, ScriptVM::IN_EEPROM);
+    } else {
+      vm.load(composite_script, sizeof(composite_script), ScriptVM::IN_FLASH);
+    }
+  }
+  vm.render(pattern, frame);
+}
+
+void Layered(PatternBuffer &pattern, unsigned frame, AnimationState &) {
+  static const Layer layers[] = {
+    { RotaryCorruption, PatternBuffer::BLEND_OR },
+    { RadialSeeds,      PatternBuffer::BLEND_XOR }
+  };
+  static Compositor<2> compositor(layers);
+  compositor.render(pattern, frame);
+}
+
+// Rotating spokes that breathe, with thin bands drifting the other way.
+void Vortex(PatternBuffer &pattern, unsigned frame, AnimationState &) {
+  if (frame == 0) pattern.setRotation(0);
+  const uint8_t t = frame;
+  PolarRenderer polar(pattern);
+  polar.setBlend(PatternBuffer::BLEND_COPY);
+  polar.spokes(4, 3*t, 12 + PolarRenderer::sine(2*t)/16);
+  polar.setBlend(PatternBuffer::BLEND_XOR);
+  polar.wave(3, -5*t, 100);
+}
+
+// Shows frames streamed from a host (see framestream.h).
+void Streamed(PatternBuffer &pattern, unsigned frame, AnimationState &) {
+  if (frame == 0) {
+    pattern.clear();
+    pattern.setRotation(0);
+  }
+  frame_stream.present(pattern);
+}
+
+// Spokes that swell with the loudness of the soundtrack and spin with
+// the bass, plus sparkles for the treble.  Without the audio input,
+// the spokes just turn.
+void Pulse(PatternBuffer &pattern, unsigned frame, AnimationState &state) {
+  if (frame == 0) {
+    pattern.setRotation(0);
+    state.phase = 0;
+  }
+  const auto &levels = audio_input.levels();
+  state.phase += 1 + levels.low / 32;
+  PolarRenderer polar(pattern);
+  polar.setBlend(PatternBuffer::BLEND_COPY);
+  polar.spokes(6, state.phase, 4 + levels.envelope / 8);
+  for (uint8_t i = levels.high / 32; i > 0; --i) {
+    pattern.togglePixel(rng.below(pattern.size()));
+  }
+}
+
+const char marquee_message[] PROGMEM = "Enter the tunnel... if you dare!";
+
+void Marquee(PatternBuffer &pattern, unsigned frame, AnimationState &state) {
+  if (frame == 0) state.scroller = TextScroller(marquee_message);
+  state.scroller.render(pattern, frame);
 }
 
 #endif
@@ -0,0 +1,3 @@
+#include "audioinput.h"
+
+AudioInput audio_input;
@@ -0,0 +1,166 @@
+// Audio input
+// Adrian McCarthy 2022
+
+// Samples the soundtrack so animations can react to it.  Tap the
+// audio module's DAC output (or speaker line) through a capacitor to
+// an analog pin biased at mid-supply by a pair of equal resistors.
+//
+// The ADC runs free at 125 kHz (prescaler 128), which gives about 9600
+// 8-bit samples per second.  The ADC interrupt feeds each sample to
+// `sample`, which does a fixed amount of work:  a few 16-bit adds and
+// constant shifts, with no multiplies and no data-dependent loops.
+//
+// Counting instructions, a sample takes about 180 cycles plus about 70
+// for the ISR's entry, register saves, and exit, so roughly 250 cycles
+// (16 us).  At 9600 samples per second, that's about 2.4 million
+// cycles per second, or 15% of the CPU.  The CPU utilization from the
+// `stats` command shows the real cost.
+//
+// The ISR is declared ISR_NOBLOCK, so avr-gcc makes `sei` its first
+// instruction, ahead of the register saves.  A pixel clock interrupt
+// that arrives as the sampler starts waits only for the vector jump
+// and the `sei` (about 8 cycles), and after that it preempts the
+// sampler at any point.  Nesting costs stack:  the pixel ISR's frame
+// on top of the sampler's, about 20 bytes.  The sampler finishes far
+// sooner than the next conversion (1664 cycles), so it never nests
+// with itself.
+//
+// Per sample, the sampler removes the DC offset, splits the signal
+// into three bands with a pair of one-pole low-pass filters (below
+// about 100 Hz, up to about 800 Hz, and the rest), sums the magnitude
+// of each band, and runs an envelope follower with a fast attack and
+// a release of about 50 ms.  Every BLOCK samples (about 13 ms), it
+// hands the results to the main loop.  Call `update` from the loop;
+// animations read `levels` when they render, so they see the latest
+// block once per revolution.
+//
+// While sampling, the sampler owns the ADC.  Anything else that needs
+// an analog reading must use `read` instead of `analogRead`.
+
+#ifndef AUDIOINPUT_H
+#define AUDIOINPUT_H
+
+#include <Arduino.h>
+
+// Each level is 0 to 255.
+struct AudioLevels {
+  uint8_t envelope;
+  uint8_t low;
+  uint8_t mid;
+  uint8_t high;
+};
+
+class AudioInput {
+  public:
+    static constexpr uint8_t BLOCK = 128;
+
+    AudioInput() :
+      m_running(false), m_mux(0), m_dc(0), m_low(0), m_lowpass(0),
+      m_envelope(0), m_sums(), m_count(0), m_block(), m_ready(false),
+      m_levels() {}
+
+    void begin(uint8_t pin) {
+      // AVcc reference, left-adjusted so ADCH is an 8-bit sample.
+      m_mux = _BV(REFS0) | _BV(ADLAR) | ((pin - A0) & 0x07);
+      if (pin - A0 < 6) DIDR0 |= _BV(pin - A0);  // disable digital input
+      m_running = true;
+      start();
+    }
+
+    bool running() const { return m_running; }
+
+    // Reads another analog pin, pausing the sampler if necessary.
+    int read(uint8_t pin) {
+      if (!m_running) return analogRead(pin);
+      // Stop free running and let the current conversion finish.
+      ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+      while (ADCSRA & _BV(ADSC)) {}
+      const int value = analogRead(pin);
+      start();
+      return value;
+    }
+
+    // Called from the ADC ISR.
+    void sample(uint8_t raw) {
+      const int16_t centered = static_cast<int16_t>(raw) - 128;
+      m_dc += centered - (m_dc >> 8);  // m_dc is 256 times the offset
+      // Scale up by 16 so the filters keep some fraction bits.
+      const int16_t x = (centered - (m_dc >> 8)) << 4;
+      m_low += (x - m_low) >> 4;
+      m_lowpass += (x - m_lowpass) >> 1;
+      m_sums[0] += magnitude(m_low) >> 4;
+      m_sums[1] += magnitude(m_lowpass - m_low) >> 4;
+      m_sums[2] += magnitude(x - m_lowpass) >> 4;
+
+      const uint16_t level = magnitude(x) << 4;
+      if (level > m_envelope) {
+        m_envelope += (level - m_envelope) >> 2;
+      } else {
+        m_envelope -= m_envelope >> 9;
+      }
+
+      if (++m_count == BLOCK) {
+        m_block[0] = m_envelope >> 8;
+        for (uint8_t i = 0; i < 3; ++i) {
+          m_block[i + 1] = m_sums[i];
+          m_sums[i] = 0;
+        }
+        m_count = 0;
+        m_ready = true;
+      }
+    }
+
+    // Picks up the latest block.  Returns true if there was a new one.
+    bool update() {
+      if (!m_ready) return false;
+      noInterrupts();
+      uint16_t block[4];
+      for (uint8_t i = 0; i < 4; ++i) block[i] = m_block[i];
+      m_ready = false;
+      interrupts();
+      m_levels.envelope = clamp(block[0]);
+      // The band sums are of BLOCK magnitudes, so this is twice their
+      // mean, which makes ordinary program material more visible.
+      m_levels.low  = clamp(block[1] >> 6);
+      m_levels.mid  = clamp(block[2] >> 6);
+      m_levels.high = clamp(block[3] >> 6);
+      return true;
+    }
+
+    const AudioLevels &levels() const { return m_levels; }
+
+  private:
+    void start() {
+      ADMUX = m_mux;
+      ADCSRB = 0;  // free running
+      // Writing ADIF clears any result left over from `analogRead`.
+      ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIF) | _BV(ADIE) |
+               _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+    }
+
+    static uint16_t magnitude(int16_t x) {
+      return static_cast<uint16_t>(x < 0 ? -x : x);
+    }
+    static uint8_t clamp(uint16_t x) { return x > 255 ? 255 : x; }
+
+    bool m_running;
+    uint8_t m_mux;
+
+    // Touched only by the ISR.
+    int16_t m_dc;
+    int16_t m_low;
+    int16_t m_lowpass;
+    uint16_t m_envelope;
+    uint16_t m_sums[3];
+    uint8_t m_count;
+
+    // Handed from the ISR to the loop.
+    volatile uint16_t m_block[4];
+    volatile bool m_ready;
+
+    AudioLevels m_levels;
+};
+
+extern AudioInput audio_input;
+
+#endif
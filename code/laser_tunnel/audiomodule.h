@@ -153,6 +153,86 @@ struct Audio {
   };
 };
 
+// Decodes a message from the module and calls the corresponding hook
+// on `handler`.  AudioEventHandler uses this with virtual hooks, and
+// StaticAudioEventHandler uses it with hooks resolved at compile time.
+template <typename Handler>
+void dispatchAudioMessage(Handler &handler, const Audio::Message &msg) {
+  switch (msg.getMessageID()) {
+    case 0x3A: {
+      const auto mask = msg.getParamLo();
+      if (mask & 0x01) handler.onDeviceInserted(Audio::DEV_USB);
+      if (mask & 0x02) handler.onDeviceInserted(Audio::DEV_SDCARD);
+      if (mask & 0x04) handler.onDeviceInserted(Audio::DEV_AUX);
+      return;
+    }
+    case 0x3B: {
+      const auto mask = msg.getParamLo();
+      if (mask & 0x01) handler.onDeviceRemoved(Audio::DEV_USB);
+      if (mask & 0x02) handler.onDeviceRemoved(Audio::DEV_SDCARD);
+      if (mask & 0x04) handler.onDeviceRemoved(Audio::DEV_AUX);
+      return;
+    }
+    case 0x3C: return handler.onFinishedFile(Audio::DEV_USB, msg.getParam());
+    case 0x3D: return handler.onFinishedFile(Audio::DEV_SDCARD, msg.getParam());
+    case 0x3E: return handler.onFinishedFile(Audio::DEV_FLASH, msg.getParam());
+
+    // Initialization complete
+    case 0x3F: {
+      uint16_t devices = 0;
+      const auto mask = msg.getParamLo();
+      if (mask & 0x01) devices = devices | (1u << Audio::DEV_USB);
+      if (mask & 0x02) devices = devices | (1u << Audio::DEV_SDCARD);
+      if (mask & 0x04) devices = devices | (1u << Audio::DEV_AUX);
+      if (mask & 0x10) devices = devices | (1u << Audio::DEV_FLASH);
+      return handler.onInitComplete(devices);
+    }
+
+    case 0x40:
+      return handler.onError(static_cast<Audio::ErrorCode>(msg.getParamLo()));
+    
+    // ACK
+    case 0x41:
+      return handler.onAck();
+
+    // Query responses
+    case 0x42: {
+      // Only Flyron documents this response to the status query.
+      // The DFPlayer Mini always seems to report SDCARD even when
+      // the selected and active device is USB, so maybe it uses
+      // the high byte to signal something else?  Catalex also
+      // always reports the SDCARD, but it only has an SDCARD.
+      Audio::Device device = Audio::DEV_SLEEP;
+      switch (msg.getParamHi()) {
+        case 0x01: device = Audio::DEV_USB;     break;
+        case 0x02: device = Audio::DEV_SDCARD;  break;
+      }
+      Audio::ModuleState state = Audio::MS_ASLEEP;
+      switch (msg.getParamLo()) {
+        case 0x00: state = Audio::MS_STOPPED;  break;
+        case 0x01: state = Audio::MS_PLAYING;  break;
+        case 0x02: state = Audio::MS_PAUSED;   break;
+      }
+      return handler.onStatus(device, state);
+    }
+    case 0x43: return handler.onVolume(msg.getParamLo());
+    case 0x44:
+      return handler.onEqualizer(static_cast<Audio::Equalizer>(msg.getParamLo()));
+    case 0x45:
+      return handler.onPlaybackSequence(static_cast<Audio::Sequence>(msg.getParamLo()));
+    case 0x46: return handler.onFirmwareVersion(msg.getParam());
+    case 0x47: return handler.onDeviceFileCount(Audio::DEV_USB, msg.getParam());
+    case 0x48: return handler.onDeviceFileCount(Audio::DEV_SDCARD, msg.getParam());
+    case 0x49: return handler.onDeviceFileCount(Audio::DEV_FLASH, msg.getParam());
+    case 0x4B: return handler.onCurrentTrack(Audio::DEV_USB, msg.getParam());
+    case 0x4C: return handler.onCurrentTrack(Audio::DEV_SDCARD, msg.getParam());
+    case 0x4D: return handler.onCurrentTrack(Audio::DEV_FLASH, msg.getParam());
+    case 0x4E: return handler.onFolderTrackCount(msg.getParam());
+    case 0x4F: return handler.onFolderCount(msg.getParam());
+    default: break;
+  }
+}
+
 class BasicAudioEventHandler : public Audio {
   public:
     virtual void onMessageSent(const Message &/*msg*/) {}
@@ -160,12 +240,16 @@ class BasicAudioEventHandler : public Audio {
     virtual void onTimedOut() {}
 };
 
+// The module calls the hooks of a `Handler`.  By default, that's a
+// BasicAudioEventHandler with virtual hooks.  For a handler derived
+// from StaticAudioEventHandler, the calls are resolved at compile time.
+template <typename Handler = BasicAudioEventHandler>
 class BasicAudioModule : public Audio {
   public:
     explicit BasicAudioModule(Stream &stream) :
       m_stream(stream), m_in(), m_out(), m_timeout(), m_handler(nullptr) {}
 
-    virtual void begin(BasicAudioEventHandler *handler = nullptr) {
+    void begin(Handler *handler = nullptr) {
       m_handler = handler;
     }
 
@@ -442,19 +526,19 @@ class BasicAudioModule : public Audio {
     Device   m_source;   // the currently selected device
     uint16_t m_files;    // the number of files on the selected device
     uint8_t  m_folders;  // the number of folders on the selected device
-    BasicAudioEventHandler *m_handler;
+    Handler *m_handler;
 };
 
-template <typename SerialType>
-class AudioModule : public BasicAudioModule {
+template <typename SerialType, typename Handler = BasicAudioEventHandler>
+class AudioModule : public BasicAudioModule<Handler> {
   public:
     explicit AudioModule(SerialType &serial) :
-      BasicAudioModule(serial), m_serial(serial) {}
+      BasicAudioModule<Handler>(serial), m_serial(serial) {}
 
     // Initialization to be done during `setup`.
-    void begin(BasicAudioEventHandler *handler) override {
+    void begin(Handler *handler) {
       m_serial.begin(9600);
-      BasicAudioModule::begin(handler);
+      BasicAudioModule<Handler>::begin(handler);
     }
 
   private:
@@ -489,6 +573,46 @@ class AudioEventHandler : public BasicAudioEventHandler {
     virtual void onVolume(uint8_t /*volume*/) {};
 };
 
+// AudioEventHandler goes through two levels of virtual functions for
+// each message, and each handler class has a vtable, which the AVR
+// keeps in RAM.  Alternatively, derive your handler `H` from
+// StaticAudioEventHandler<H>, declare just the hooks you need (public,
+// but not virtual), and use an AudioModule<SerialType, H>.  The module
+// then calls the handler directly, and the hooks you don't declare
+// are empty inline functions that compile away.
+//
+// The virtual handlers remain for when the handler must be chosen at
+// run time, and for DebugAudioEventHandler, which logs everything.
+template <typename Derived>
+class StaticAudioEventHandler : public Audio {
+  public:
+    void onMessageSent(const Message &/*msg*/) {}
+    void onMessageReceived(const Message &msg) {
+      dispatchAudioMessage(derived(), msg);
+    }
+    void onTimedOut() { derived().onError(EC_TIMEDOUT); }
+
+    void onAck() {}
+    void onCurrentTrack(Device /*src*/, uint16_t /*track*/) {}
+    void onDeviceInserted(Device /*src*/) {}
+    void onDeviceFileCount(Device /*src*/, uint16_t /*count*/) {}
+    void onDeviceRemoved(Device /*src*/) {}
+    void onError(ErrorCode /*code*/) {}
+    void onEqualizer(Equalizer /*eq*/) {}
+    void onFinishedFile(Device /*src*/, uint16_t /*file_index*/) {}
+    void onFirmwareVersion(uint16_t /*version*/) {}
+    void onFolderCount(uint16_t /*count*/) {}
+    void onFolderTrackCount(uint16_t /*count*/) {}
+    void onInitComplete(uint16_t /*devices*/) {}
+    void onMessageInvalid() {}
+    void onPlaybackSequence(Sequence /*seq*/) {}
+    void onStatus(Device /*device*/, ModuleState /*state*/) {}
+    void onVolume(uint8_t /*volume*/) {}
+
+  private:
+    Derived &derived() { return *static_cast<Derived *>(this); }
+};
+
 #ifndef NDEBUG
 class DebugAudioEventHandler : public AudioEventHandler {
   public:
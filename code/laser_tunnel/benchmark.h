@@ -0,0 +1,71 @@
+// Polar primitive benchmarks
+// Adrian McCarthy 2022
+
+// Times each polar primitive and prints the average cost per call,
+// so we know how many fit in a frame.  At 3000 RPM, a frame (one
+// revolution) is 20 ms, and the loop has other work to do, so an
+// animation should stay well under that.
+//
+// A frame during a transition renders both animations and then blends
+// them, so `benchmarkTransitions` compares that with a plain frame.
+// The whole frame must fit in the state task's budget (2 ms).
+//
+// The sketch runs these only when BENCHMARK is set.
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <Arduino.h>
+#include "animator.h"
+#include "patternbuffer.h"
+#include "polar.h"
+
+template <typename Fn>
+void benchmark(const __FlashStringHelper *name, Fn fn) {
+  constexpr uint8_t RUNS = 16;
+  const auto start = micros();
+  for (uint8_t i = 0; i < RUNS; ++i) fn(i);
+  const auto elapsed = micros() - start;
+  Serial.print(name);
+  Serial.print(F(": "));
+  Serial.print(elapsed / RUNS);
+  Serial.println(F(" us"));
+}
+
+void benchmarkPolar() {
+  PatternBuffer pattern;
+  PolarRenderer polar(pattern);
+  polar.setBlend(PatternBuffer::BLEND_XOR);
+  benchmark(F("sector"), [&](uint8_t i) { polar.sector(3*i, 100); });
+  benchmark(F("spokes"), [&](uint8_t i) { polar.spokes(6, 5*i, 10); });
+  benchmark(F("wave"), [&](uint8_t i) { polar.wave(5, 7*i, 40); });
+  benchmark(F("interference"), [&](uint8_t i) {
+    polar.interference(7, 3*i, 8, 0, 0);
+  });
+}
+
+void benchmarkTransitions() {
+  Animator animator;
+  PatternBuffer pattern;
+  volatile bool rev_flag = false;
+  const auto frame = [&](uint8_t) {
+    rev_flag = true;
+    animator.update(rev_flag, pattern);
+  };
+  // Long enough that the transition is still going after all the runs.
+  const auto blend = [&](Transition transition) {
+    animator.setAnimation(Vortex);
+    frame(0);
+    animator.transitionTo(Spokes, pattern, transition, 255);
+  };
+  animator.setAnimation(Spokes);
+  benchmark(F("frame"), frame);
+  blend(TRANSITION_WIPE);
+  benchmark(F("wipe frame"), frame);
+  blend(TRANSITION_DISSOLVE);
+  benchmark(F("dissolve frame"), frame);
+  blend(TRANSITION_ROTATE_OUT);
+  benchmark(F("rotate-out frame"), frame);
+}
+
+#endif
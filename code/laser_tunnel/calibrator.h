@@ -5,16 +5,41 @@
 
 class Calibrator {
   public:
-    Calibrator() : m_samples(250), m_avg_period(0uL) {}
+    static constexpr int RESUME_REVS = 8;
+    static constexpr unsigned long RESUME_TIMEOUT = 3000;  // ms
+
+    Calibrator() :
+      m_fan(nullptr), m_samples(250), m_avg_period(0uL), m_resuming(false) {}
 
     void begin(Fan &fan) {
       Serial.println("Measuring fan speed...");
+      m_fan = &fan;
       m_avg_period = 0ul;
+      m_variance = 0ul;
       m_last_rev_time = micros();
+      m_start_time = m_settled_time = millis();
       m_samples = 250;
+      m_resuming = false;
       fan.run(fanISR);
     }
 
+    // Picks up from an earlier calibration, as after a warm restart
+    // (see failsafe.h), when the fan is probably still coasting at
+    // about the right speed.  Once RESUME_REVS revolutions in a row
+    // come within 2% of `period`, that's the calibration.  If that
+    // doesn't happen within RESUME_TIMEOUT, it starts over with `begin`.
+    void resume(Fan &fan, unsigned long period, uint16_t duty) {
+      Serial.println(F("Resuming fan calibration..."));
+      m_fan = &fan;
+      m_avg_period = period;
+      m_variance = 0ul;
+      m_last_rev_time = micros();
+      m_start_time = m_settled_time = millis();
+      m_samples = RESUME_REVS;
+      m_resuming = true;
+      fan.run(fanISR, duty);
+    }
+
     bool update() {
       if (rev_time) {
         noInterrupts();
@@ -23,31 +48,82 @@ class Calibrator {
         interrupts();
         const auto period = this_rev_time - m_last_rev_time;
         m_last_rev_time = this_rev_time;
-        m_avg_period = (15*m_avg_period + period + 8) / 16;
+        // When resuming, the earlier calibration stands unless the fan
+        // strays from it.
+        if (!m_resuming) m_avg_period = (15*m_avg_period + period + 8) / 16;
+        m_fan->regulate(period);
+
+        // Track how steady the speed is.  The fan is considered to
+        // have spun up once the period stays within 2% of the average.
+        const long deviation =
+          static_cast<long>(period) - static_cast<long>(m_avg_period);
+        const unsigned long dev = abs(deviation);
+        if (dev > m_avg_period / 50) {
+          m_settled_time = millis();
+          if (m_resuming) m_samples = RESUME_REVS + 1;
+        }
+        if (dev < 0x10000ul) {
+          m_variance = (15*m_variance + dev*dev + 8) / 16;
+        }
         --m_samples;
       }
+      if (m_resuming && m_samples > 0 &&
+          millis() - m_start_time > RESUME_TIMEOUT) {
+        begin(*m_fan);
+      }
       return m_samples <= 0;
     }
 
     unsigned long fanPeriod() const { return m_avg_period; }
 
+    // Time from `begin` until the fan speed settled, in milliseconds.
+    unsigned long spinUpTime() const { return m_settled_time - m_start_time; }
+
+    // A running estimate of the variance of the revolution period,
+    // in microseconds squared.
+    unsigned long periodVariance() const { return m_variance; }
+
+    // Prints the results of the calibration a line per step, so the
+    // console can print them without blocking (see console.h).
+    // Returns true if there's more.
+    bool printReport(uint8_t step, uint16_t pattern_size) const {
+      const auto period = m_avg_period;
+      switch (step) {
+        case 0:
+          Serial.print(F("  Revolution time: "));
+          Serial.print(period);
+          Serial.println(F(" us (average)"));
+          return true;
+        case 1: {
+          const auto freq = 1000000ul * 100ul / period;
+          const auto rpm = (60 * freq + 50) / 100;
+          Serial.print(F("  Speed:           "));
+          Serial.print(rpm);
+          Serial.println(F(" RPM"));
+          return true;
+        }
+        case 2:
+          Serial.print(F("For "));
+          Serial.print(pattern_size);
+          Serial.print(F(" pixels per revolution, PixelTimer must run at "));
+          Serial.print(pixelFrequency(period, pattern_size));
+          Serial.println(F(" Hz."));
+          return true;
+        case 3:
+          Serial.print(F("  Spin-up time:    "));
+          Serial.print(spinUpTime());
+          Serial.println(F(" ms"));
+          return true;
+        default:
+          Serial.print(F("  Period std dev:  "));
+          Serial.print(sqrt(static_cast<float>(m_variance)));
+          Serial.println(F(" us"));
+          return false;
+      }
+    }
+
     static float pixelFrequency(unsigned long period, uint16_t pattern_size) {
-      const auto freq = 1000000ul * 100ul / period;
-      const auto rpm = (60 * freq + 50) / 100;
-      Serial.print(F("  Revolution time: "));
-      Serial.print(period);
-      Serial.println(F(" us (average)"));
-      Serial.print(F("  Speed:           "));
-      Serial.print(rpm);
-      Serial.println(F(" RPM"));
-      
-      const float pixel_freq = 1.0e6 * pattern_size / period;
-      Serial.print(F("For "));
-      Serial.print(pattern_size);
-      Serial.print(F(" pixels per revolution, PixelTimer must run at "));
-      Serial.print(pixel_freq);
-      Serial.println(F(" Hz."));
-      return pixel_freq;
+      return 1.0e6 * pattern_size / period;
     }
 
   private:
@@ -62,9 +138,14 @@ class Calibrator {
     static bool half_rev;
     static volatile unsigned long rev_time;
 
+    Fan *m_fan;
     int m_samples;
     unsigned long m_avg_period;
+    unsigned long m_variance;
     unsigned long m_last_rev_time;
+    unsigned long m_start_time;
+    unsigned long m_settled_time;
+    bool m_resuming;
 };
 
 #endif
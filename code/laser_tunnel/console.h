@@ -0,0 +1,193 @@
+// Serial command console
+// Adrian McCarthy 2022
+
+// A line-oriented console for tuning and diagnostics over the serial
+// port.  Like the ScriptLoader, it's non-blocking:  pass it the bytes
+// received with `receive`, which just collects the line, and call
+// `update` each time through `loop`.
+//
+// A line is a command name and optional arguments separated by spaces,
+// ending with CR or LF.  A '?' at the beginning of a line is a
+// complete command by itself, for compatibility with hosts that used
+// to send just that.
+//
+// Printing can stall `loop` once the serial transmit buffer fills, so
+// `update` runs a command only when the buffer has room for a line of
+// output.  A command with more to say returns true, and the console
+// calls it again (with the next step number) on a later pass, after
+// the buffer has drained.  That way no single pass waits on the
+// serial port, as long as no step prints more than OUTPUT_ROOM.
+//
+// Other code can use the same mechanism for reports that aren't a
+// response to a command (see `report`).
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include <stdlib.h>
+#include <string.h>
+
+// `args` is the rest of the line (possibly empty).  Return true to be
+// called again with the next step.
+using CommandHandler = bool (*)(const char *args, uint8_t step);
+
+struct Command {
+  const char *name;  // in PROGMEM
+  CommandHandler run;
+};
+
+template <uint8_t N>
+class Console {
+  public:
+    static constexpr uint8_t MAX_LINE = 32;
+    // Each step can print this much without blocking.  The longest
+    // step, the exposure statistics with every number at its widest,
+    // is 62 characters (counting CR LF).  HardwareSerial's transmit
+    // buffer holds 63, so no step can be longer than that.
+    static constexpr uint8_t OUTPUT_ROOM = 62;
+
+    // `commands` must be in PROGMEM.
+    explicit Console(const Command (&commands)[N]) :
+      m_commands(commands), m_length(0), m_ready(false), m_overflow(false),
+      m_step(0), m_running(nullptr), m_report(nullptr), m_reporting(false),
+      m_args(m_line) {}
+
+    void receive(uint8_t b) {
+      if (m_ready) return;  // still working on the last line
+      if (b == '\r' || b == '\n') {
+        if (m_length > 0 && !m_overflow) m_ready = true;
+        else m_length = 0;
+        m_overflow = false;
+        return;
+      }
+      if (b == '\b' || b == 0x7F) {
+        if (m_length > 0) --m_length;
+        return;
+      }
+      if (b < ' ' || b > '~' || b == '#') return;
+      if (m_length == 0 && b == '?') {
+        m_line[m_length++] = '?';
+        m_ready = true;
+        return;
+      }
+      if (m_length == MAX_LINE) {
+        m_overflow = true;
+        return;
+      }
+      m_line[m_length++] = static_cast<char>(b);
+    }
+
+    // Discards a partial line, for when the bytes turn out to be part
+    // of a message for someone else.
+    void cancel() {
+      if (m_ready) return;
+      m_length = 0;
+      m_overflow = false;
+    }
+
+    // Prints a report in steps, the way a command does, once any
+    // command in progress has finished.  `steps` gets an empty `args`.
+    // A report that hasn't started yet is replaced.
+    void report(CommandHandler steps) { m_report = steps; }
+
+    void update() {
+      if (!m_ready && m_report == nullptr && m_running == nullptr) return;
+      if (Serial.availableForWrite() < OUTPUT_ROOM) return;
+      if (m_running == nullptr && m_report != nullptr) {
+        m_running = m_report;
+        m_report = nullptr;
+        m_reporting = true;
+        m_args = "";
+        m_step = 0;
+      } else if (m_running == nullptr) {
+        m_line[m_length] = '\0';
+        char *args = m_line;
+        while (*args != '\0' && *args != ' ') ++args;
+        if (*args == ' ') *args++ = '\0';
+        while (*args == ' ') ++args;
+        m_args = args;
+        m_step = 0;
+        m_running = find(m_line);
+        if (m_running == nullptr) {
+          Serial.print(F("Unknown command: "));
+          Serial.println(m_line);
+          finish();
+          return;
+        }
+      }
+      if (!(*m_running)(m_args, m_step++)) finish();
+    }
+
+    // Prints the name of command `i`, ending the line after the last
+    // one.  Returns true if there are more.
+    bool printCommand(uint8_t i) const {
+      Serial.print(reinterpret_cast<const __FlashStringHelper *>(
+        pgm_read_ptr(&m_commands[i].name)));
+      if (i + 1 < N) {
+        Serial.print(' ');
+        return true;
+      }
+      Serial.println();
+      return false;
+    }
+
+    // Helpers for parsing arguments.  Both return a pointer past the
+    // word or number, or nullptr if there isn't one.
+    static const char *nextWord(const char *args, char *word, uint8_t size) {
+      while (*args == ' ') ++args;
+      if (*args == '\0') return nullptr;
+      uint8_t i = 0;
+      while (*args != '\0' && *args != ' ') {
+        if (i + 1 < size) word[i++] = *args;
+        ++args;
+      }
+      word[i] = '\0';
+      return args;
+    }
+
+    static const char *nextNumber(const char *args, long &value) {
+      char *end = nullptr;
+      value = strtol(args, &end, 10);
+      return end == args ? nullptr : end;
+    }
+
+  private:
+    using Handler = CommandHandler;
+
+    Handler find(const char *name) const {
+      for (uint8_t i = 0; i < N; ++i) {
+        const auto command_name =
+          static_cast<const char *>(pgm_read_ptr(&m_commands[i].name));
+        if (strcmp_P(name, command_name) == 0) {
+          return reinterpret_cast<Handler>(pgm_read_ptr(&m_commands[i].run));
+        }
+      }
+      return nullptr;
+    }
+
+    void finish() {
+      m_running = nullptr;
+      if (m_reporting) {
+        // Leave the command line alone.
+        m_reporting = false;
+        return;
+      }
+      m_length = 0;
+      m_ready = false;
+    }
+
+    const Command *m_commands;
+    char m_line[MAX_LINE + 1];
+    uint8_t m_length;
+    bool m_ready;
+    bool m_overflow;
+    uint8_t m_step;
+    Handler m_running;
+    Handler m_report;
+    bool m_reporting;
+    const char *m_args;
+};
+
+#endif
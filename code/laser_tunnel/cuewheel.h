@@ -0,0 +1,193 @@
+// Cue Wheel
+// Adrian McCarthy 2022
+
+// Sequences the props during an effect--fog, house lights, animation
+// changes, and sounds--at specific times after the effect begins.
+//
+// Cues are kept in a hashed timer wheel.  Time advances in ticks of
+// TICK_MS milliseconds, and each tick looks only at the cues in its
+// own slot, so the cost per tick doesn't depend on how many cues are
+// scheduled.  A cue more than one turn of the wheel in the future
+// carries a count of the turns still to go.
+//
+// A cue list is an array of `Cue`s in PROGMEM, in order by offset,
+// ending with a CUE_END.  The offset of the CUE_END is the nominal
+// length of the list, and `load` scales all of the offsets so that
+// the end lands at the actual duration of the effect (typically the
+// length of the startle track).
+
+#ifndef CUEWHEEL_H
+#define CUEWHEEL_H
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+
+enum CueAction : uint8_t {
+  CUE_END,          // the effect is over
+  CUE_FOG_ON,
+  CUE_FOG_OFF,
+  CUE_LIGHTS_ON,
+  CUE_LIGHTS_OFF,
+  CUE_ANIMATION,    // arg selects the animation, 0xFF for the next one
+  CUE_SOUND         // arg is the SoundFX track
+};
+
+struct Cue {
+  uint16_t offset;  // milliseconds after the start of the effect
+  CueAction action;
+  uint8_t arg;
+};
+
+template <uint8_t CAPACITY>
+class CueWheel {
+  public:
+    static constexpr uint8_t TICK_SHIFT = 4;
+    static constexpr uint8_t TICK_MS = 1 << TICK_SHIFT;
+
+    CueWheel() : m_last_tick(0), m_cursor(0), m_count(0) { clear(); }
+
+    // Cancels all of the cues and restarts the clock at `now`.
+    void start(unsigned long now) {
+      clear();
+      m_last_tick = now;
+    }
+
+    // Moves the wheel's clock ahead by `delta` ms (or back, if it's
+    // negative), so that the cues come that much sooner (or later).
+    void shift(long delta) { m_last_tick -= delta; }
+
+    void clear() {
+      for (auto &head : m_slots) head = NIL;
+      m_ready = NIL;
+      m_free = 0;
+      m_count = 0;
+      for (uint8_t i = 0; i < CAPACITY; ++i) m_entries[i].next = i + 1;
+      m_entries[CAPACITY - 1].next = NIL;
+    }
+
+    // True if any cues have yet to be delivered.
+    bool pending() const { return m_count != 0; }
+
+    // Schedules a cue `delay` milliseconds from the last tick.  Cues
+    // scheduled for the same tick are delivered in the order they were
+    // scheduled.  Returns false if the wheel is full.
+    bool schedule(unsigned long delay, CueAction action, uint8_t arg = 0) {
+      if (m_free == NIL) return false;
+      const auto i = m_free;
+      auto &entry = m_entries[i];
+      m_free = entry.next;
+      ++m_count;
+      entry.action = action;
+      entry.arg = arg;
+      entry.next = NIL;
+
+      const auto ticks = delay >> TICK_SHIFT;
+      if (ticks == 0) {
+        entry.rounds = 0;
+        append(m_ready, i);
+        return true;
+      }
+      const auto turns = (ticks - 1) >> SLOT_BITS;
+      entry.rounds = turns < 0xFFFFul ? turns : 0xFFFFu;
+      append(m_slots[(m_cursor + ticks) & SLOT_MASK], i);
+      return true;
+    }
+
+    // Schedules the cues from a list in PROGMEM, scaling the offsets so
+    // that the list's CUE_END lands `duration` ms from now.  With a
+    // `duration` of 0, the offsets are used as is.
+    void load(const Cue *list, unsigned long duration = 0) {
+      uint16_t nominal = 0;
+      for (const Cue *p = list; ; ++p) {
+        nominal = pgm_read_word(&p->offset);
+        if (pgm_read_byte(&p->action) == CUE_END) break;
+      }
+      // The scale factor is fixed point with 8 fractional bits.
+      uint32_t scale = 0x100;
+      if (duration != 0 && nominal != 0) {
+        scale = (duration << 8) / nominal;
+        if (scale > 0xFFFF) scale = 0xFFFF;
+      }
+      for (const Cue *p = list; ; ++p) {
+        const uint32_t offset = pgm_read_word(&p->offset);
+        const auto action = static_cast<CueAction>(pgm_read_byte(&p->action));
+        schedule((offset * scale) >> 8, action, pgm_read_byte(&p->arg));
+        if (action == CUE_END) break;
+      }
+    }
+
+    // Advances the wheel to `now` and hands back the next cue that's
+    // due, if any.  Call this frequently; the caller acts on the cue,
+    // which can safely schedule or clear cues.
+    bool poll(unsigned long now, Cue &cue) {
+      if (m_count == 0) {
+        // Nothing to wait for, so don't bother ticking.
+        m_last_tick = now;
+        return false;
+      }
+      while (m_ready == NIL) {
+        if (now - m_last_tick < TICK_MS) return false;
+        m_last_tick += TICK_MS;
+        tick();
+      }
+      const auto i = m_ready;
+      auto &entry = m_entries[i];
+      m_ready = entry.next;
+      cue.offset = 0;
+      cue.action = entry.action;
+      cue.arg = entry.arg;
+      entry.next = m_free;
+      m_free = i;
+      --m_count;
+      return true;
+    }
+
+  private:
+    static constexpr uint8_t SLOT_BITS = 4;
+    static constexpr uint8_t SLOTS = 1 << SLOT_BITS;
+    static constexpr uint8_t SLOT_MASK = SLOTS - 1;
+    static constexpr uint8_t NIL = 0xFF;
+    static_assert(CAPACITY < NIL, "CueWheel capacity too large");
+
+    struct Entry {
+      uint8_t next;
+      CueAction action;
+      uint8_t arg;
+      uint16_t rounds;
+    };
+
+    // Moves the cues that are due in the current slot to the ready list
+    // and counts down the rest.
+    void tick() {
+      m_cursor = (m_cursor + 1) & SLOT_MASK;
+      auto *link = &m_slots[m_cursor];
+      while (*link != NIL) {
+        const auto i = *link;
+        auto &entry = m_entries[i];
+        if (entry.rounds != 0) {
+          --entry.rounds;
+          link = &entry.next;
+          continue;
+        }
+        *link = entry.next;
+        entry.next = NIL;
+        append(m_ready, i);
+      }
+    }
+
+    void append(uint8_t &head, uint8_t i) {
+      auto *link = &head;
+      while (*link != NIL) link = &m_entries[*link].next;
+      *link = i;
+    }
+
+    unsigned long m_last_tick;
+    uint8_t m_cursor;
+    uint8_t m_slots[SLOTS];
+    uint8_t m_ready;
+    uint8_t m_free;
+    uint8_t m_count;
+    Entry m_entries[CAPACITY];
+};
+
+#endif
@@ -0,0 +1,184 @@
+// DFPlayer emulator
+// Adrian McCarthy 2022
+
+// A stand-in for a DFPlayer Mini that speaks the serial protocol (see
+// audiomodule.h), for trying out the sound code and timing startup
+// without the module.  It's a Stream, so it can replace the
+// SoftwareSerial in SoundFX (see SOUNDFX_SERIAL in soundfx.h), and it
+// works in host builds, where millis() is whatever the test makes it.
+//
+// Bytes written to the emulator are parsed as commands.  Replies are
+// queued with a delay and become available to read once their time
+// comes.  Like the real module, it:
+//
+// * answers a reset with "init complete" after a long pause, and
+//   reports an error for anything else sent before then,
+// * sends an ACK for commands that ask for feedback,
+// * sends "finished file" twice when a track ends,
+// * reports card insertion and removal (see `insertCard` and
+//   `removeCard`).
+//
+// The delays are plausible guesses, not measurements.  Adjust `Timing`
+// to match a particular module.
+
+#ifndef DFPLAYEREMULATOR_H
+#define DFPLAYEREMULATOR_H
+
+#include <Arduino.h>
+#include "audiomodule.h"
+
+class DFPlayerEmulator : public Stream, private Audio {
+  public:
+    struct Timing {
+      unsigned long reply;       // ms for ACKs and query responses
+      unsigned long reset;       // ms from reset to init complete
+      unsigned long select;      // ms from select source to init complete
+      unsigned long file_count;  // ms to count the files
+      unsigned long track;       // ms each track plays
+    };
+    static Timing defaultTiming() { return { 20, 1500, 200, 100, 5000 }; }
+
+    // The pins are ignored; they're accepted so the emulator can be
+    // constructed just like a SoftwareSerial.
+    DFPlayerEmulator(int /*rx_pin*/ = -1, int /*tx_pin*/ = -1,
+                     uint16_t file_count = 3,
+                     const Timing &timing = defaultTiming()) :
+      m_timing(timing), m_file_count(file_count), m_inserted(true),
+      m_busy_until(0), m_playing(0), m_finish_time(0), m_volume(30),
+      m_in(), m_out(), m_out_index(0), m_queue(), m_count(0) {}
+
+    void begin(long /*baud*/) {}
+
+    void insertCard() {
+      m_inserted = true;
+      queue(MID_DEVICEINSERTED, 0x0002, m_timing.reply);
+    }
+
+    void removeCard() {
+      m_inserted = false;
+      m_playing = 0;
+      queue(MID_DEVICEREMOVED, 0x0002, m_timing.reply);
+    }
+
+    // Stream
+    int available() override {
+      pump();
+      return m_out.getLength() - m_out_index;
+    }
+    int read() override {
+      if (available() == 0) return -1;
+      return m_out.getBuffer()[m_out_index++];
+    }
+    int peek() override {
+      if (available() == 0) return -1;
+      return m_out.getBuffer()[m_out_index];
+    }
+    size_t write(uint8_t b) override {
+      if (m_in.receive(b) && m_in.isValid()) receive(m_in);
+      return 1;
+    }
+    using Print::write;
+
+  private:
+    struct Reply {
+      MsgID msgid;
+      uint16_t param;
+      unsigned long time;
+    };
+    static constexpr uint8_t QUEUE_SIZE = 4;
+
+    void receive(const Message &msg) {
+      const auto now = millis();
+      const auto msgid = msg.getMessageID();
+      const auto param = msg.getParam();
+      if (static_cast<long>(now - m_busy_until) < 0) {
+        queue(MID_ERROR, EC_NOSOURCES, m_timing.reply);
+        return;
+      }
+      switch (msgid) {
+        case MID_RESET:
+          m_playing = 0;
+          m_busy_until = now + m_timing.reset;
+          if (m_inserted) queue(MID_INITCOMPLETE, 0x0002, m_timing.reset);
+          break;
+        case MID_SELECTSOURCE:
+          m_playing = 0;
+          m_busy_until = now + m_timing.select;
+          if (m_inserted) queue(MID_INITCOMPLETE, 0x0002, m_timing.select);
+          break;
+        case MID_PLAYFILE:
+          if (!m_inserted) return queue(MID_ERROR, EC_NOSOURCES, m_timing.reply);
+          if (param == 0 || m_file_count < param) {
+            return queue(MID_ERROR, EC_FILEOUTOFRANGE, m_timing.reply);
+          }
+          m_playing = param;
+          m_finish_time = now + m_timing.track;
+          break;
+        case MID_STOP:
+          m_playing = 0;
+          break;
+        case MID_SETVOLUME:
+          m_volume = param > 30 ? 30 : param;
+          break;
+        case MID_SDFILECOUNT:
+          queue(MID_SDFILECOUNT, m_inserted ? m_file_count : 0, m_timing.file_count);
+          return;
+        case MID_STATUS:
+          queue(MID_STATUS, m_playing != 0 ? 0x0201 : 0x0200, m_timing.reply);
+          return;
+        case MID_VOLUME:
+          queue(MID_VOLUME, m_volume, m_timing.reply);
+          return;
+        case MID_CURRENTSDFILE:
+          queue(MID_CURRENTSDFILE, m_playing, m_timing.reply);
+          return;
+        default:
+          return queue(MID_ERROR, EC_UNSUPPORTED, m_timing.reply);
+      }
+      if (msg.getBuffer()[4] == FEEDBACK) queue(MID_ACK, 0, m_timing.reply);
+    }
+
+    // Queues a reply, keeping the queue in time order.
+    void queue(MsgID msgid, uint16_t param, unsigned long delay) {
+      if (m_count == QUEUE_SIZE) return;
+      const auto time = millis() + delay;
+      uint8_t i = m_count++;
+      while (i > 0 && static_cast<long>(time - m_queue[i - 1].time) < 0) {
+        m_queue[i] = m_queue[i - 1];
+        --i;
+      }
+      m_queue[i] = { msgid, param, time };
+    }
+
+    // Makes the next reply available to read once its time has come.
+    void pump() {
+      const auto now = millis();
+      if (m_playing != 0 && static_cast<long>(now - m_finish_time) >= 0) {
+        queue(MID_FINISHEDSDFILE, m_playing, 0);
+        queue(MID_FINISHEDSDFILE, m_playing, 0);
+        m_playing = 0;
+      }
+      if (m_out_index < m_out.getLength() || m_count == 0) return;
+      const auto &reply = m_queue[0];
+      if (static_cast<long>(now - reply.time) < 0) return;
+      m_out.set(reply.msgid, reply.param, NO_FEEDBACK);
+      m_out_index = 0;
+      --m_count;
+      for (uint8_t i = 0; i < m_count; ++i) m_queue[i] = m_queue[i + 1];
+    }
+
+    const Timing m_timing;
+    uint16_t m_file_count;
+    bool m_inserted;
+    unsigned long m_busy_until;
+    uint16_t m_playing;
+    unsigned long m_finish_time;
+    uint8_t m_volume;
+    Message m_in;
+    Message m_out;
+    int m_out_index;
+    Reply m_queue[QUEUE_SIZE];
+    uint8_t m_count;
+};
+
+#endif
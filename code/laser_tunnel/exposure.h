@@ -0,0 +1,99 @@
+// Exposure limiter
+// Adrian McCarthy 2022
+
+// Keeps track of how much of the time the laser is on and dims
+// patterns that would keep it on more than a set limit.
+//
+// Since the pattern is scanned out unchanged for a whole revolution,
+// counting its lit pixels once per revolution (in the loop, not the
+// ISR) gives the exposure for that revolution exactly.  The limiter
+// keeps the counts for the last WINDOW revolutions and compares their
+// average to the limit.
+//
+// To dim, the limiter sets the pattern's output mask to light only k
+// of every 8 pixels, with k chosen so the average stays under the
+// limit.  The mask rotates each revolution, so the dimming is spread
+// over time rather than blanking the same pixels every revolution.
+// That costs the pixel ISR a single AND.
+
+#ifndef EXPOSURE_H
+#define EXPOSURE_H
+
+#include <Arduino.h>
+#include "patternbuffer.h"
+
+// Output masks with 0 through 8 bits set, spread out.
+const uint8_t exposure_masks[9] PROGMEM = {
+  0x00, 0x80, 0x88, 0xA4, 0xAA, 0xB5, 0xEE, 0xFE, 0xFF
+};
+
+class ExposureLimiter {
+  public:
+    static constexpr uint8_t WINDOW = 16;
+
+    explicit ExposureLimiter(uint8_t limit_percent = 50) :
+      m_counts(), m_next(0), m_total(0), m_level(8),
+      m_rotation(0), m_limit(limit_percent), m_limited(0) {}
+
+    void setLimit(uint8_t percent) { m_limit = percent > 100 ? 100 : percent; }
+    uint8_t limit() const { return m_limit; }
+
+    // Call once per revolution with the pattern being shown.
+    void update(PatternBuffer &pattern) {
+      const auto lit = pattern.countLit();
+      m_total += lit - m_counts[m_next];
+      m_counts[m_next] = lit;
+      m_next = (m_next + 1) % WINDOW;
+
+      // Choose the most pixels out of 8 that keeps the average of what
+      // we'd emit under the limit.
+      const uint32_t allowed = static_cast<uint32_t>(m_limit) * pattern.size() * WINDOW / 100;
+      uint8_t level = 8;
+      if (m_total > allowed) {
+        level = static_cast<uint8_t>(allowed * 8 / m_total);
+        if (m_limited < 0xFFFFFFFFul) ++m_limited;
+      }
+      m_level = level;
+      m_rotation = (m_rotation + 1) & 0b0111;
+      const uint8_t mask = pgm_read_byte(&exposure_masks[m_level]);
+      pattern.setOutputMask((mask >> m_rotation) | (mask << (8 - m_rotation)));
+    }
+
+    // Forgets the history, as when the pattern is cleared.
+    void reset(PatternBuffer &pattern) {
+      for (auto &count : m_counts) count = 0;
+      m_total = 0;
+      m_level = 8;
+      pattern.setOutputMask(0xFF);
+    }
+
+    // Average percentage of pixels lit in the pattern, before dimming.
+    uint8_t averagePercent() const {
+      return static_cast<uint8_t>(m_total * 100 / (256u * WINDOW));
+    }
+
+    // Pixels out of every 8 being shown.
+    uint8_t level() const { return m_level; }
+
+    void printStatistics() const {
+      Serial.print(F("Exposure: avg="));
+      Serial.print(averagePercent());
+      Serial.print(F("%, limit="));
+      Serial.print(m_limit);
+      Serial.print(F("%, level="));
+      Serial.print(m_level);
+      Serial.print(F("/8, dimmed="));
+      Serial.println(m_limited);
+    }
+
+  private:
+    uint16_t m_counts[WINDOW];
+    uint8_t m_next;
+    uint16_t m_total;
+    uint8_t m_level;
+    uint8_t m_rotation;
+    uint8_t m_limit;
+    unsigned long m_limited;  // revolutions dimmed
+};
+
+#endif
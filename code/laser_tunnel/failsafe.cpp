@@ -0,0 +1,199 @@
+#include <Arduino.h>
+#include <stddef.h>
+#include "failsafe.h"
+
+namespace {
+
+constexpr uint16_t MAGIC = 0x5AFE;
+
+// Everything that survives a reset.  After a power-on, it's garbage,
+// which the magic number and checksum catch.
+struct Persistent {
+  uint16_t magic;
+  uint8_t restarts;  // crashes since the tunnel was last healthy
+  Calibration calibration;
+  CrashRecord crash;
+  uint8_t check;
+};
+
+Persistent persistent __attribute__((section(".noinit")));
+uint8_t reset_flags __attribute__((section(".noinit")));
+
+// Unlike the persistent record, these start from zero each time.
+CrashRecord last_crash;
+volatile uint16_t assertion_line = 0;
+void (*kill_handler)() = nullptr;
+void (*crash_handler)() = nullptr;
+
+uint8_t checksum() {
+  const auto bytes = reinterpret_cast<const uint8_t *>(&persistent);
+  uint8_t sum = 0;
+  for (size_t i = 0; i < offsetof(Persistent, check); ++i) {
+    // Rotating first means a run of zeros still changes the sum.
+    sum = static_cast<uint8_t>((sum << 1) | (sum >> 7)) + bytes[i];
+  }
+  return sum;
+}
+
+bool valid() {
+  return persistent.magic == MAGIC && persistent.check == checksum();
+}
+
+void seal() {
+  persistent.magic = MAGIC;
+  persistent.check = checksum();
+}
+
+}
+
+// This runs in .init3, after the stack pointer is set up but before
+// the constructors, to turn off the watchdog before it can bite again.
+// Optiboot clears MCUSR itself and hands the old value over in r2.
+void saveResetFlags() __attribute__((naked, used, section(".init3")));
+void saveResetFlags() {
+  uint8_t flags = MCUSR;
+  if (flags == 0) __asm volatile ("mov %0, r2" : "=r" (flags));
+  reset_flags = flags;
+  MCUSR = 0;
+  wdt_disable();
+}
+
+bool checkRestart(Calibration &calibration) {
+  if (!valid()) {
+    memset(&persistent, 0, sizeof(persistent));
+  }
+  // Every watchdog reset is a crash.  Without a record, WDT_vect
+  // couldn't run (see failsafe.h).
+  const bool crashed = (reset_flags & _BV(WDRF)) != 0;
+  if (crashed && persistent.crash.reason == CRASH_NONE) {
+    persistent.crash.reason = CRASH_HANG;
+    persistent.crash.state = UNKNOWN_STATE;
+  }
+  if (crashed) {
+    last_crash = persistent.crash;
+    if (persistent.restarts < 0xFF) ++persistent.restarts;
+  } else {
+    persistent.restarts = 0;
+  }
+  persistent.crash = CrashRecord();
+
+  const bool warm = crashed && persistent.calibration.fan_period != 0 &&
+                    persistent.restarts <= MAX_WARM_RESTARTS;
+  if (warm) calibration = persistent.calibration;
+  // A cold start measures the fan again.
+  else persistent.calibration = Calibration();
+  seal();
+  return warm;
+}
+
+const CrashRecord &lastCrash() { return last_crash; }
+
+namespace {
+
+bool hasTime(const CrashRecord &crash) {
+  return crash.reason != CRASH_NONE && crash.state != UNKNOWN_STATE;
+}
+
+}
+
+void printCrash(const CrashRecord &crash) {
+  printCrashReason(crash);
+  printCrashTime(crash);
+}
+
+void printCrashReason(const CrashRecord &crash) {
+  switch (crash.reason) {
+    case CRASH_NONE:
+      Serial.println(F("No crash"));
+      return;
+    case CRASH_HANG:
+      if (crash.state == UNKNOWN_STATE) {
+        Serial.println(F("Hang with interrupts off (no record)"));
+        return;
+      }
+      Serial.print(F("Hang"));
+      break;
+    case CRASH_ASSERTION:
+      Serial.print(F("Assertion failure on line "));
+      Serial.print(crash.line);
+      break;
+  }
+  Serial.print(F(" in state "));
+  Serial.println(crash.state);
+}
+
+bool printCrashTime(const CrashRecord &crash) {
+  if (!hasTime(crash)) return false;
+  Serial.print(F("  at "));
+  Serial.print(crash.time);
+  Serial.print(F(" ms, "));
+  Serial.print(crash.now - crash.rev_start);
+  Serial.println(F(" us after the last fan pulse"));
+  return true;
+}
+
+unsigned long crashLatency(const CrashRecord &crash) {
+  if (crash.reason == CRASH_NONE) return 0;
+  // Without WDT_vect, the reset waits for a second timeout.
+  if (crash.state == UNKNOWN_STATE) return 2*WATCHDOG_TIMEOUT;
+  // A failed assertion doesn't wait for the watchdog (though printing
+  // the message takes a few more ms).
+  if (crash.reason == CRASH_ASSERTION) return WATCHDOG_RESET_DELAY;
+  return WATCHDOG_TIMEOUT + WATCHDOG_RESET_DELAY;
+}
+
+void saveCalibration(const Calibration &calibration) {
+  persistent.calibration = calibration;
+  seal();
+}
+
+void markHealthy() {
+  if (persistent.restarts == 0) return;
+  persistent.restarts = 0;
+  seal();
+}
+
+void startWatchdog() {
+  noInterrupts();
+  wdt_reset();
+  // Changing the mode takes a timed sequence.  With WDIE and WDE both
+  // set, the first timeout interrupts, and the hardware clears WDIE,
+  // so the next one resets even if the ISR never gets to run.
+  WDTCSR = _BV(WDCE) | _BV(WDE);
+  WDTCSR = _BV(WDIE) | _BV(WDE) | _BV(WDP2) | _BV(WDP1);  // 1 s
+  interrupts();
+}
+
+void stopWatchdog() { wdt_disable(); }
+
+void setCrashHandlers(void (*kill)(), void (*crash)()) {
+  kill_handler = kill;
+  crash_handler = crash;
+}
+
+void emergencyKill() {
+  if (kill_handler != nullptr) kill_handler();
+}
+
+void assertionReset(uint16_t line) {
+  noInterrupts();
+  assertion_line = line;
+  if (crash_handler != nullptr) crash_handler();
+  // Before `setup` registers the handlers, there's no state to record.
+  crashReset(UNKNOWN_STATE, 0);
+}
+
+void crashReset(uint8_t state, unsigned long rev_start) {
+  noInterrupts();
+  auto &crash = persistent.crash;
+  crash.reason = assertion_line != 0 ? CRASH_ASSERTION : CRASH_HANG;
+  crash.state = state;
+  crash.line = assertion_line;
+  crash.time = millis();
+  crash.rev_start = rev_start;
+  crash.now = micros();
+  seal();
+  // Don't wait another second for the reset.
+  wdt_enable(WDTO_15MS);
+  for (;;) {}
+}
@@ -0,0 +1,120 @@
+// Fail-safe
+// Adrian McCarthy 2022
+
+// If the loop stops running for a second, the watchdog fires.  Its
+// interrupt (WDT_vect, in the sketch) turns off the laser and the fog,
+// records what was going on, and then resets the MCU.  A failed
+// assertion does the same right away, through the crash handlers the
+// sketch registers, without waiting for the watchdog (or needing it to
+// be running).
+//
+// An ISR that never returns (or anything else that leaves interrupts
+// off) keeps WDT_vect from running, so there's no record.  The
+// watchdog resets the MCU a second later anyway, and `checkRestart`
+// logs that as a hang in an unknown state.  Nothing turns off the laser
+// and the fog until the reset makes their pins inputs, so they can
+// stay on for up to two seconds.
+//
+// The crash record and the last good fan calibration live in .noinit
+// RAM, which the C runtime doesn't clear, so they survive the reset.
+// When the sketch restarts after a crash, `checkRestart` tells it
+// whether it can warm start:  skip the self-test, leave the audio
+// module alone, and resume with the saved calibration while the fan is
+// still spinning, rather than spinning up and measuring from scratch.
+// If the fan isn't where it was, the calibrator falls back to a full
+// calibration.  A unit that keeps crashing gets a cold start after
+// MAX_WARM_RESTARTS tries.
+//
+// The watchdog stays enabled across a reset, so it must be turned off
+// before anything slow runs.  failsafe.cpp does that in .init3, before
+// the constructors.  The stock Pro Mini bootloader doesn't, and it can
+// get stuck resetting forever; use Optiboot.
+
+#ifndef FAILSAFE_H
+#define FAILSAFE_H
+
+#include <Arduino.h>
+#include <avr/wdt.h>
+
+enum CrashReason : uint8_t {
+  CRASH_NONE,
+  CRASH_HANG,       // the loop stopped feeding the watchdog
+  CRASH_ASSERTION   // an ASSERT failed (see aidassert.h)
+};
+
+struct CrashRecord {
+  CrashReason reason;
+  uint8_t state;            // the sketch's State, or UNKNOWN_STATE
+  uint16_t line;            // of the failed assertion
+  unsigned long time;       // millis() when the watchdog fired
+  unsigned long rev_start;  // micros() of the last fan pulse
+  unsigned long now;        // micros() when the watchdog fired
+};
+
+struct Calibration {
+  unsigned long fan_period;  // us
+  uint16_t rpm;              // target speed, 0 for unregulated
+  uint16_t duty;             // fan duty once settled
+};
+
+// The crash happened with interrupts off, so WDT_vect never ran.
+constexpr uint8_t UNKNOWN_STATE = 0xFF;
+
+constexpr uint8_t MAX_WARM_RESTARTS = 3;
+
+// Milliseconds from the last `feedWatchdog` to the watchdog interrupt
+// (nominal; the watchdog oscillator isn't precise).
+constexpr unsigned long WATCHDOG_TIMEOUT = 1000;
+
+// Milliseconds from the watchdog interrupt to the reset.
+constexpr unsigned long WATCHDOG_RESET_DELAY = 16;
+
+// Call early in `setup`.  Returns true, with the saved calibration,
+// if the last reset was a crash and the sketch may warm start.
+bool checkRestart(Calibration &calibration);
+
+// The crash that caused the last reset, if there was one.
+const CrashRecord &lastCrash();
+void printCrash(const CrashRecord &crash);
+// The same in two short lines, for the console.  `printCrashTime`
+// returns false if there's nothing to print.
+void printCrashReason(const CrashRecord &crash);
+bool printCrashTime(const CrashRecord &crash);
+
+// The most milliseconds that can pass between the fault and the reset.
+// Optiboot starts the sketch right away after a watchdog reset, so add
+// millis() to get the time from the fault.
+unsigned long crashLatency(const CrashRecord &crash);
+
+// Remembers a good calibration for the next warm start.
+void saveCalibration(const Calibration &calibration);
+
+// Call once the tunnel has run long enough to be considered healthy,
+// so that a later crash gets warm starts again.
+void markHealthy();
+
+// Enables the watchdog in interrupt-then-reset mode with a timeout of
+// WATCHDOG_TIMEOUT.  The loop must call `feedWatchdog` more often than that.
+void startWatchdog();
+void stopWatchdog();
+inline void feedWatchdog() { wdt_reset(); }
+
+// The sketch's side of a crash, which WDT_vect and failed assertions
+// share.  `kill` turns off the laser and the fog, and `crash` fills in
+// the crash record with the sketch's state and resets the MCU (by
+// calling `crashReset`).  Both run with interrupts off.
+void setCrashHandlers(void (*kill)(), void (*crash)());
+
+// For aidassert.cpp:  turns off the laser and the fog, if the sketch
+// has registered its handlers.
+void emergencyKill();
+
+// For aidassert.cpp:  records the failed assertion and resets the MCU
+// within WATCHDOG_RESET_DELAY.
+[[noreturn]] void assertionReset(uint16_t line);
+
+// For the watchdog ISR:  fills in the crash record and resets the MCU
+// within WATCHDOG_RESET_DELAY.
+[[noreturn]] void crashReset(uint8_t state, unsigned long rev_start);
+
+#endif
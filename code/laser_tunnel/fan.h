@@ -5,30 +5,123 @@
 #include "aidassert.h"
 #include "pins.h"
 
+// The fan's speed is controlled with a 25 kHz PWM signal (per the
+// Intel 4-wire fan spec), generated by Timer2 on OC2B, which is pin 3.
+// That means the pixel clock must use a different timer.
+//
+// If a target speed is set, `regulate` runs a PI controller that
+// adjusts the duty cycle each revolution to hold that speed, so the
+// pixel frequency stays constant.  Without a target, the fan runs at
+// full speed, as it did with on/off control.
 class Fan {
   public:
     Fan(int tach_pin, int pwm_pin) :
-      m_tach(tach_pin), m_pwm(pwm_pin) {}
+      m_tach(tach_pin), m_pwm(pwm_pin),
+      m_target_period(0), m_duty(0), m_last_error(0) {}
 
     void begin() {
       // The tachometer output from the fan must be connected
       // to a pin that can generate external interrupts.
       ASSERT(digitalPinToInterrupt(m_tach) != NOT_AN_INTERRUPT);
       m_tach.begin(INPUT_PULLUP);
+      // The PWM must be on Timer2's output B.
+      ASSERT(m_pwm == 3);
       m_pwm.begin(LOW);
+
+      // Fast PWM with OCR2A as TOP (mode 7), prescaler 8:
+      // 16 MHz / 8 / (PWM_TOP + 1) = 25 kHz.
+      TCCR2A = (1 << WGM21) | (1 << WGM20);
+      TCCR2B = (1 << WGM22) | (1 << CS21);
+      OCR2A = PWM_TOP;
+      OCR2B = 0;
     }
 
-    void run(void (*pfn_isr)() = nullptr) {
+    void run(void (*pfn_isr)() = nullptr, uint16_t duty = FULL) {
       const auto interrupt = digitalPinToInterrupt(m_tach);
       if (pfn_isr == nullptr) detachInterrupt(interrupt);
       else attachInterrupt(interrupt, pfn_isr, FALLING);
-      m_pwm.set();
+      // Spin up at full speed (or at `duty`, when resuming a known
+      // speed).  If there's a target speed, the controller will back
+      // off once we get there.  If the fan is already running (e.g.,
+      // we're just switching ISRs), leave the speed alone.
+      if (!running()) setDuty(duty);
+    }
+
+    // Full power, to restart a stalled fan or get back up to speed.
+    void spinUp() { setDuty(FULL); }
+
+    bool running() const { return (TCCR2A & (1 << COM2B1)) != 0; }
+
+    void stop() {
+      // Disconnect the PWM so that the pin is held low.  A duty of 0
+      // would still give a tiny pulse each period.
+      TCCR2A &= ~((1 << COM2B1) | (1 << COM2B0));
+      m_pwm.clear();
+    }
+
+    // Sets the speed to hold.  0 means run at full speed unregulated.
+    void setTargetRPM(unsigned rpm) {
+      m_target_period = (rpm == 0) ? 0 : 60000000ul / rpm;
+      m_last_error = 0;
+    }
+
+    unsigned long targetPeriod() const { return m_target_period; }
+
+    // The duty cycle as a fraction of FULL.
+    uint16_t duty() const { return m_duty; }
+
+    // Call once per revolution with the measured revolution period in
+    // microseconds.
+    void regulate(unsigned long period) {
+      if (m_target_period == 0) return;
+      // A positive error means we're too slow.
+      long error = static_cast<long>(period) - static_cast<long>(m_target_period);
+      // Ignore wild measurements (like a missed tach pulse) rather than
+      // letting them kick the controller.
+      const long limit = static_cast<long>(m_target_period / 2);
+      if (error > limit) error = limit;
+      if (error < -limit) error = -limit;
+
+      // Velocity form of PI:  the proportional term acts on the change
+      // in error and the integral term on the error itself.  Clamping
+      // the output is then all the anti-windup we need.
+      const long delta = (KP * (error - m_last_error) + KI * error) / GAIN_SCALE;
+      m_last_error = error;
+      long duty = static_cast<long>(m_duty) + delta;
+      if (duty < MIN_DUTY) duty = MIN_DUTY;
+      if (duty > FULL) duty = FULL;
+      setDuty(static_cast<uint16_t>(duty));
     }
-    void stop() { m_pwm.clear(); }
+
+    // Duty cycle in units of 1/FULL.
+    static constexpr uint16_t FULL = 0x4000;
 
   private:
+    static constexpr uint8_t PWM_TOP = 79;
+    // Controller gains, scaled by GAIN_SCALE.  The error is in
+    // microseconds.  These were chosen conservatively; tune for a
+    // particular fan by watching the period statistics.
+    static constexpr long KP = 16;
+    static constexpr long KI = 1;
+    static constexpr long GAIN_SCALE = 8;
+    // Many fans stall below about 20% duty.
+    static constexpr long MIN_DUTY = FULL / 5;
+
+    // The timer gives only PWM_TOP + 1 steps, so the controller keeps
+    // finer resolution in m_duty, and the output will dither between
+    // adjacent steps.
+    void setDuty(uint16_t duty) {
+      m_duty = duty;
+      // OCR2B == TOP gives a constant high output.
+      OCR2B = static_cast<uint8_t>((static_cast<uint32_t>(duty) * PWM_TOP + FULL/2) / FULL);
+      TCCR2A = (TCCR2A & ~(1 << COM2B0)) | (1 << COM2B1);
+    }
+
     DigitalInputPin m_tach;
     DigitalOutputPin m_pwm;
+    unsigned long m_target_period;
+    uint16_t m_duty;
+    long m_last_error;
 };
 
 #endif
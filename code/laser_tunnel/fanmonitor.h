@@ -0,0 +1,189 @@
+#ifndef FANMONITOR_H
+#define FANMONITOR_H
+
+#include <Arduino.h>
+
+// Watches the revolution periods while the display is running and
+// compares them to the calibrated period.  If the tach signal stops,
+// the fan slows drastically, or the speed drifts far enough that the
+// pixel clock no longer matches, the pattern would be smeared or
+// parked on a stationary mirror, so the monitor reports a fault and
+// the sketch gates the laser and recalibrates.
+class FanMonitor {
+  public:
+    enum Fault : uint8_t {
+      NONE,
+      STALL,          // no revolutions for several periods
+      MISSED_PULSES,  // several consecutive revolutions missed pulses
+      DRIFT           // the average period moved away from calibration
+    };
+
+    FanMonitor() :
+      m_calibrated(0), m_last_start(0), m_last_seen(0), m_last_period(0),
+      m_min(0), m_max(0), m_mean(0), m_revolutions(0), m_missed(0),
+      m_consecutive_misses(0), m_faults(0), m_synced(false),
+      m_slipped(false), m_fault(NONE) {}
+
+    // Resets the statistics and starts monitoring.  `rev_start` is the
+    // current value of the revolution start time, which may be stale,
+    // and `now` is the current time, both in microseconds.
+    void begin(unsigned long calibrated_period, unsigned long rev_start,
+               unsigned long now) {
+      m_calibrated = calibrated_period;
+      m_last_start = rev_start;
+      m_last_seen = now;
+      m_last_period = 0;
+      m_min = 0xFFFFFFFFul;
+      m_max = 0;
+      m_mean = calibrated_period;
+      m_revolutions = 0;
+      m_missed = 0;
+      m_consecutive_misses = 0;
+      m_synced = false;
+      m_slipped = false;
+      m_fault = NONE;
+    }
+
+    // Call each time through `loop` with the start time of the most
+    // recent revolution and the current time, both in microseconds.
+    // Returns true if a new revolution has completed since the last
+    // call.  Check `fault` and `slipped` afterwards.
+    bool update(unsigned long rev_start, unsigned long now) {
+      m_slipped = false;
+      if (m_calibrated == 0 || m_fault != NONE) return false;
+
+      if (rev_start == m_last_start) {
+        if (now - m_last_seen > STALL_PERIODS * m_calibrated) {
+          setFault(STALL);
+        }
+        return false;
+      }
+
+      const auto period = rev_start - m_last_start;
+      m_last_start = rev_start;
+      m_last_seen = rev_start;
+      // The first revolution start after `begin` or a slip tells us
+      // only where the next revolution begins.
+      if (!m_synced) {
+        m_synced = true;
+        return false;
+      }
+
+      // With two tach pulses per revolution, a missed pulse makes the
+      // revolution look half again as long (or longer, if it missed
+      // more).  An odd number of misses also means the ISR is now
+      // treating the middle of each revolution as the start, so the
+      // pattern is half a revolution out until the sketch flips the
+      // toggle back.
+      if (4*period > 5*m_calibrated) {
+        const auto halves = (2*period + m_calibrated/2) / m_calibrated;
+        const auto missed = halves - 2;
+        m_missed += missed;
+        if (missed & 1) {
+          m_slipped = true;
+          m_synced = false;
+        }
+        if (++m_consecutive_misses >= MAX_CONSECUTIVE_MISSES) {
+          setFault(MISSED_PULSES);
+        }
+        return false;
+      }
+      m_consecutive_misses = 0;
+
+      m_last_period = period;
+      ++m_revolutions;
+      if (period < m_min) m_min = period;
+      if (period > m_max) m_max = period;
+      m_mean = (15*m_mean + period + 8) / 16;
+
+      const auto drift = (m_mean > m_calibrated) ? m_mean - m_calibrated
+                                                 : m_calibrated - m_mean;
+      if (drift > m_calibrated / DRIFT_DIVISOR) setFault(DRIFT);
+      return true;
+    }
+
+    // True if the last `update` found that an odd number of tach
+    // pulses were missed, so the ISR's half-revolution toggle is out
+    // of phase.
+    bool slipped() const { return m_slipped; }
+
+    Fault fault() const { return m_fault; }
+
+    unsigned long lastPeriod() const { return m_last_period; }
+    unsigned long calibratedPeriod() const { return m_calibrated; }
+    unsigned long minPeriod() const { return m_revolutions ? m_min : 0; }
+    unsigned long maxPeriod() const { return m_max; }
+    unsigned long meanPeriod() const { return m_mean; }
+    unsigned long revolutions() const { return m_revolutions; }
+    unsigned long missedPulses() const { return m_missed; }
+    unsigned faultCount() const { return m_faults; }
+
+    // Three short lines, so the console can print them one at a time.
+    void printPeriods() const {
+      Serial.print(F("Fan period: cal="));
+      Serial.print(m_calibrated);
+      Serial.print(F(" mean="));
+      Serial.print(m_mean);
+      Serial.println(F(" us"));
+    }
+
+    void printRange() const {
+      Serial.print(F("Fan period: min="));
+      Serial.print(minPeriod());
+      Serial.print(F(" max="));
+      Serial.print(m_max);
+      Serial.println(F(" us"));
+    }
+
+    void printCounts() const {
+      Serial.print(F("Fan: revs="));
+      Serial.print(m_revolutions);
+      Serial.print(F(", missed="));
+      Serial.print(m_missed);
+      Serial.print(F(", faults="));
+      Serial.println(m_faults);
+    }
+
+    void printStatistics() const {
+      printPeriods();
+      printRange();
+      printCounts();
+    }
+
+    static void printFaultName(Fault fault) {
+      switch (fault) {
+        case NONE:          Serial.print(F("none")); break;
+        case STALL:         Serial.print(F("stall")); break;
+        case MISSED_PULSES: Serial.print(F("missed pulses")); break;
+        case DRIFT:         Serial.print(F("drift")); break;
+        default:            Serial.print(F("???")); break;
+      }
+    }
+
+  private:
+    static constexpr unsigned long STALL_PERIODS = 3;
+    static constexpr uint8_t MAX_CONSECUTIVE_MISSES = 3;
+    static constexpr unsigned long DRIFT_DIVISOR = 8;  // 12.5%
+
+    void setFault(Fault fault) {
+      m_fault = fault;
+      ++m_faults;
+    }
+
+    unsigned long m_calibrated;
+    unsigned long m_last_start;
+    unsigned long m_last_seen;
+    unsigned long m_last_period;
+    unsigned long m_min;
+    unsigned long m_max;
+    unsigned long m_mean;
+    unsigned long m_revolutions;
+    unsigned long m_missed;
+    uint8_t m_consecutive_misses;
+    unsigned m_faults;
+    bool m_synced;
+    bool m_slipped;
+    Fault m_fault;
+};
+
+#endif
@@ -0,0 +1,3 @@
+#include "framestream.h"
+
+FrameStream frame_stream;
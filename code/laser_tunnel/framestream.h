@@ -0,0 +1,214 @@
+// Frame streaming
+// Adrian McCarthy 2022
+
+// Receives frames from a host over the serial port so new content can
+// be shown without rebuilding the firmware.  Like the ScriptLoader,
+// the receiver is non-blocking:  pass it the bytes received with
+// `receive`.  The bytes are decoded straight into a back buffer, and
+// `present` copies the back buffer to the display buffer, at most once
+// per revolution.
+//
+// The host sends either:
+//
+//   '#', 'F', 32 bytes, checksum     a key frame
+//   '#', 'D', tokens..., checksum    a delta frame
+//
+// The tokens of a delta frame are the skip, literal, and run tokens of
+// a SequencePlayer sequence (see sequence.h).  They are applied to the
+// previous frame and must account for exactly 32 bytes.  The checksum
+// is the low byte of the sum of the bytes after the type.
+//
+// Flow control:  the receiver writes '>' each time it presents a frame,
+// meaning it's ready for another.  The host should have at most one
+// frame in flight.  If a frame starts decoding over one that hasn't
+// been presented, the previous one is dropped (and counted).  After a
+// checksum mismatch, the back buffer can't be trusted, so the receiver
+// writes '!' and ignores delta frames until the next key frame.  The
+// same goes for a frame whose bytes stop for more than BYTE_TIMEOUT,
+// which also frees the serial port for the console.  Bytes still in the
+// receive buffer arrived in time, so a slow loop doesn't count as a
+// stall.
+//
+// The receiver is fed from the HardwareSerial receive buffer, which
+// the USART interrupt fills, rather than from its own interrupt
+// handler, since the Arduino core owns the USART vectors.
+//
+// See code/tools/stream.py for a host sender.
+
+#ifndef FRAMESTREAM_H
+#define FRAMESTREAM_H
+
+#include <Arduino.h>
+#include "patternbuffer.h"
+#include "timeout.h"
+
+class FrameStream {
+  public:
+    static constexpr unsigned long BYTE_TIMEOUT = 100;  // ms
+
+    FrameStream() :
+      m_back(), m_state(WAITING), m_k(0), m_count(0), m_token(0), m_sum(0),
+      m_apply(false), m_pending(false), m_need_key(true), m_timeout(),
+      m_last_frame(0), m_received(0), m_presented(0), m_dropped(0),
+      m_corrupted(0) {}
+
+    // Abandons a frame whose bytes stopped coming.  Call before passing
+    // along newly received bytes, with the number waiting to be read.
+    void update(int available) {
+      if (available != 0 || !m_timeout.expired()) return;
+      m_timeout.cancel();
+      // A partial frame may have changed the back buffer.
+      if (m_state != MARKED && m_apply) corrupted();
+      m_state = WAITING;
+    }
+
+    // True while a frame is partially received, so the bytes should
+    // not go anywhere else.
+    bool busy() const { return m_state != WAITING && m_state != MARKED; }
+
+    // True if a frame is waiting to be presented.
+    bool pending() const { return m_pending; }
+
+    // The time (millis) the last complete frame arrived.
+    unsigned long lastFrameTime() const { return m_last_frame; }
+
+    void receive(uint8_t b) {
+      switch (m_state) {
+        case WAITING:
+          if (b == '#') m_state = MARKED;
+          break;
+        case MARKED:
+          if (b == 'F' || b == 'D') {
+            m_k = 0;
+            m_sum = 0;
+            m_count = 0;
+            m_apply = (b == 'F') || !m_need_key;
+            // A frame we're skipping leaves the back buffer alone, so
+            // only one we decode overwrites a frame that was never
+            // shown.
+            if (m_pending && m_apply) {
+              m_pending = false;
+              ++m_dropped;
+            }
+            if (b == 'F') m_need_key = false;
+            m_state = (b == 'F') ? KEY : TOKEN;
+            break;
+          }
+          m_state = WAITING;
+          break;
+        case KEY:
+          m_sum += b;
+          if (m_apply) m_back.setByte(m_k, b);
+          if (++m_k == BYTES) m_state = CHECKING;
+          break;
+        case TOKEN:
+          m_sum += b;
+          m_token = b & ~COUNT;
+          m_count = (b & COUNT) + 1;
+          if (m_k + m_count > BYTES || m_token == HOLD) {
+            m_state = WAITING;
+            corrupted();
+            break;
+          }
+          if (m_token == SKIP) {
+            m_k += m_count;
+            m_state = (m_k == BYTES) ? CHECKING : TOKEN;
+            break;
+          }
+          m_state = DATA;
+          break;
+        case DATA:
+          m_sum += b;
+          if (m_token == LITERAL) {
+            if (m_apply) m_back.toggleByte(m_k, b);
+            ++m_k;
+            --m_count;
+          } else {
+            while (m_count > 0) {
+              if (m_apply) m_back.toggleByte(m_k, b);
+              ++m_k;
+              --m_count;
+            }
+          }
+          if (m_count == 0) m_state = (m_k == BYTES) ? CHECKING : TOKEN;
+          break;
+        case CHECKING:
+          m_state = WAITING;
+          if (b != m_sum) {
+            corrupted();
+            break;
+          }
+          if (!m_apply) break;
+          ++m_received;
+          m_pending = true;
+          m_last_frame = millis();
+          break;
+      }
+      if (m_state == WAITING) m_timeout.cancel();
+      else m_timeout.set(BYTE_TIMEOUT);
+    }
+
+    // Copies the latest complete frame into `pattern`, if there's one
+    // that hasn't been shown yet, and tells the host to send another.
+    void present(PatternBuffer &pattern) {
+      if (!m_pending) return;
+      pattern.combine(m_back, PatternBuffer::BLEND_COPY);
+      m_pending = false;
+      ++m_presented;
+      Serial.write('>');
+    }
+
+    // Two short lines, so the console can print them one at a time.
+    void printFrames() const {
+      Serial.print(F("Stream: received="));
+      Serial.print(m_received);
+      Serial.print(F(", shown="));
+      Serial.println(m_presented);
+    }
+
+    void printErrors() const {
+      Serial.print(F("Stream: dropped="));
+      Serial.print(m_dropped);
+      Serial.print(F(", bad="));
+      Serial.println(m_corrupted);
+    }
+
+    void printStatistics() const {
+      printFrames();
+      printErrors();
+    }
+
+  private:
+    enum State : uint8_t { WAITING, MARKED, KEY, TOKEN, DATA, CHECKING };
+    enum : uint8_t {
+      BYTES = 32,
+      SKIP = 0x00, LITERAL = 0x40, RUN = 0x80, HOLD = 0xC0, COUNT = 0x3F
+    };
+
+    void corrupted() {
+      ++m_corrupted;
+      m_need_key = true;
+      Serial.write('!');
+    }
+
+    PatternBuffer m_back;
+    State m_state;
+    uint8_t m_k;      // next byte of the back buffer
+    uint8_t m_count;  // bytes left for the current token
+    uint8_t m_token;
+    uint8_t m_sum;
+    bool m_apply;     // false while skipping deltas after corruption
+    bool m_pending;
+    bool m_need_key;
+    Timeout<MillisClock> m_timeout;
+    unsigned long m_last_frame;
+    unsigned long m_received;
+    unsigned long m_presented;
+    unsigned long m_dropped;
+    unsigned long m_corrupted;
+};
+
+// Shared by the serial task and the `Streamed` animation.
+extern FrameStream frame_stream;
+
+#endif
@@ -0,0 +1,81 @@
+// Idle sleep
+// Adrian McCarthy 2022
+
+// Puts the CPU into AVR idle sleep between passes through the loop.
+// Idle mode stops the CPU clock but leaves the timers, the USART, and
+// the pin-change and external interrupts running, so any interrupt
+// wakes us:  the pixel clock, the tach, serial input (hardware or
+// SoftwareSerial), or the Timer0 overflow that drives `millis`.  The
+// last one arrives every 1.024 ms, which acts as the scheduler tick
+// and bounds how long a polled input can go unnoticed.
+//
+// While the CPU sleeps, an interrupt is serviced with a fixed wake-up
+// delay instead of waiting for whatever instruction or critical
+// section the loop happened to be in, so the pixel ISR's latency is
+// much more consistent.
+//
+// The Idler also keeps track of the fraction of time spent awake.
+
+#ifndef IDLER_H
+#define IDLER_H
+
+#include <Arduino.h>
+#include <avr/sleep.h>
+
+class Idler {
+  public:
+    Idler() : m_mark(0), m_awake(0), m_asleep(0) {}
+
+    void begin() {
+      set_sleep_mode(SLEEP_MODE_IDLE);
+      m_mark = micros();
+    }
+
+    // Sleeps until the next interrupt.
+    void sleep() {
+      const auto start = micros();
+      m_awake += start - m_mark;
+      // Interrupts must be enabled or we'd never wake up.  On AVR,
+      // the instruction after `sei` always executes before any pending
+      // interrupt, so there's no window for an interrupt to sneak in
+      // between enabling interrupts and going to sleep.
+      noInterrupts();
+      sleep_enable();
+      interrupts();
+      sleep_cpu();
+      sleep_disable();
+      m_mark = micros();
+      m_asleep += m_mark - start;
+
+      // Keep the totals from overflowing while preserving the ratio.
+      if ((m_awake | m_asleep) & 0xC0000000ul) {
+        m_awake /= 2;
+        m_asleep /= 2;
+      }
+    }
+
+    // Percentage of time the CPU was awake.
+    uint8_t utilization() const {
+      const auto total = m_awake + m_asleep;
+      if (total == 0) return 100;
+      // Scaling the divisor instead of multiplying m_awake by 100
+      // keeps this from overflowing once m_awake passes 2^32 / 100 us
+      // (about 43 s).
+      return static_cast<uint8_t>(m_awake / (total / 100 + 1));
+    }
+
+    void resetStatistics() { m_awake = m_asleep = 0; }
+
+    void printStatistics() const {
+      Serial.print(F("CPU utilization: "));
+      Serial.print(utilization());
+      Serial.println(F("%"));
+    }
+
+  private:
+    unsigned long m_mark;
+    unsigned long m_awake;
+    unsigned long m_asleep;
+};
+
+#endif
@@ -17,7 +17,17 @@ class Laser {
       interrupts();
     }
 
+    // Like `disable`, but leaves interrupts off, for an ISR that must
+    // not be interrupted.
+    void kill() {
+      m_pin.clear();
+      m_enabled = false;
+    }
+
     void on() { if (m_enabled) m_pin.set(); }
+
+    // Unlike UsartLaser, this never takes the serial port.
+    bool ownsUsart() const { return false; }
     void off() { m_pin.clear(); }
 
   private:
@@ -12,20 +12,75 @@
 #include <SoftwareSerial.h>
 #include "aidassert.h"
 #include "animator.h"
+#include "audioinput.h"
+#include "benchmark.h"
 #include "calibrator.h"
+#include "console.h"
+#include "cuewheel.h"
+#include "exposure.h"
+#include "failsafe.h"
 #include "fan.h"
+#include "fanmonitor.h"
+#include "framestream.h"
+#include "idler.h"
 #include "laser.h"
+#include "memory.h"
 #include "patternbuffer.h"
 #include "pins.h"
+#include "scheduler.h"
+#include "rng.h"
+#include "scriptloader.h"
+#include "selftest.h"
 #include "soundfx.h"
+#include "startupprofiler.h"
 #include "suppressor.h"
-#include "timeout.h"
+#include "syncbus.h"
 #include "timers.h"
 #include "trigger.h"
+#include "usartlaser.h"
+
+// Set to 1 to have the USART shift out the pixels in hardware instead
+// of toggling the laser pin from the pixel clock ISR.  This requires
+// moving the laser to pin 1.  See usartlaser.h.
+#define LASER_USART 0
+
+// Set to 1 to sample the soundtrack on audio_pin so animations (like
+// Pulse) can react to it.  See audioinput.h.
+#define AUDIO_INPUT 0
+
+// Set to 1 to interlace the display:  alternate revolutions scan a
+// second field of the pattern, half a pixel later, which doubles the
+// angular resolution without raising the pixel interrupt rate.
+// Animations address the extra positions with the fine pixel functions
+// (see patternbuffer.h).  This costs 32 bytes of RAM.  It needs the
+// pixel clock, so it doesn't work with LASER_USART.
+#define INTERLACE 0
+
+#if INTERLACE && LASER_USART
+#error "INTERLACE requires the pixel clock ISR, so it can't be used with LASER_USART."
+#endif
+
+// Set to 1 to record the minimum and maximum latency of the pixel clock
+// ISR (in CPU cycles), which costs a few cycles per pixel.
+#define PROFILE_PIXEL_ISR 0
+
+// Set to 1 to check each animation against its golden CRC at startup
+// (see selftest.h).  It renders 200 frames of each one on every cold
+// boot, so turn it on to check changes to the animations, not in the
+// field.
+#define SELF_TEST 0
+
+// Set to 1 to time the polar primitives and the transitions at startup
+// and print the results (see benchmark.h).
+#define BENCHMARK 0
 
 // MCU Resources
 auto fan                  = Fan(/*tach=*/2, /*pwm=*/3);
+#if LASER_USART
+auto laser                = UsartLaser();
+#else
 auto laser                = Laser(4);
+#endif
 const auto emergency_stop = DigitalInputPin(5);
 auto suppressor           = Suppressor(6, 7, A2);
 auto trigger              = Trigger(8, 9);
@@ -34,35 +89,127 @@ const auto status_pin     = DigitalOutputPin(LED_BUILTIN);
 const auto fog_pin        = DigitalOutputPin(14);  // a.k.a. A0
 const auto house_lights_pin = DigitalOutputPin(15);  // a.k.a. A1
 const auto effect_time_pin = A3;
+const auto audio_pin = A6;
+
+// Target fan speed.  With 0, the fan runs at full speed unregulated,
+// and the pixel clock is matched to whatever that speed turns out to
+// be.  Otherwise, choose a speed the fan can comfortably reach.
+// Slower means more flicker but more time per pixel.  This can be
+// changed from the console.
+unsigned fan_target_rpm = 0;
 
 Calibrator calibrator;
-Timer<2> pixel_clock;
+FanMonitor fan_monitor;
+Idler idler;
+// Timer2 generates the fan's PWM signal, so the pixel clock uses Timer1.
+Timer<1> pixel_clock;
 
 enum class State {
   Initializing,
   Calibrating,  // measuring fan speed to set pixel clock
   Idle,         // waiting for a trigger
   Animating,
+  Streaming,    // showing frames from the host
   Stopped       // we're in the emergency stop
 } state = State::Initializing;
 
-Timeout<MillisClock> effect_timeout;
-Timeout<MillisClock> fog_timeout;
+// The props are sequenced by cues relative to the start of each effect.
+CueWheel<12> cues;
+
+// True until the current effect's CUE_END arrives.  Effects with a
+// startle track of unknown length have no CUE_END, so they end when
+// the track does.
+bool awaiting_end_cue = false;
+
+// Cue lists for the effects.  The offsets are scaled so that the
+// CUE_END lands at the end of the effect.  The pot-controlled fog off
+// cue is added when the effect begins.  For example, to bring up the
+// house lights for the last 10% and switch animations halfway:
+//
+//   { 5000, CUE_ANIMATION, 0xFF },
+//   { 9000, CUE_LIGHTS_ON, 0 },
+//   { 9990, CUE_LIGHTS_OFF, 0 },
+const Cue startle_cues[] PROGMEM = {
+  {     0, CUE_FOG_ON, 0 },
+  { 10000, CUE_END,    0 }
+};
+
+const Cue silent_cues[] PROGMEM = {
+  {     0, CUE_FOG_ON, 0 },
+  { 10000, CUE_END,    0 }
+};
 
+StartupProfiler startup;
+
+#if INTERLACE
+InterlacedPatternBuffer pattern;
+#else
 PatternBuffer pattern;
+#endif
+
+// Patterns that would keep the laser on more than this percentage of
+// the time, on average, are dimmed.  See exposure.h.
+ExposureLimiter exposure(50);
 
 Animator animator;
-Animation animations[] = { Glitch, RadialSeeds, RotaryCorruption, Composite };
+Animation animations[] = {
+  Glitch, RadialSeeds, RotaryCorruption, Composite, Layered, Spokes, Vortex,
+  Marquee, Pulse, Scripted
+};
 auto animation_index = 0;
 
+// Changing animations during an effect blends from one to the next
+// over this many revolutions (0 to cut), using each of these in turn.
+uint8_t transition_length = 40;
+const Transition transitions[] = {
+  TRANSITION_DISSOLVE, TRANSITION_WIPE, TRANSITION_ROTATE_OUT
+};
+uint8_t transition_index = 0;
+ScriptLoader script_loader;
+
+// The console can override the Effect Time pot.  An effect time of 0
+// or a fog duty of -1 means use the pot.
+unsigned long effect_time_override = 0;  // ms
+int8_t fog_duty_override = -1;           // percent
+
+// When the host stops streaming frames for this long (ms), the tunnel
+// goes back to idle.  Streaming a frame per revolution takes a faster
+// serial_baud than 9600, such as 115200.
+constexpr unsigned long stream_timeout = 2000;
+
+// Set to LEADER or FOLLOWER to keep several tunnels in step.  See
+// syncbus.h.  The sync bus needs the serial port, so it doesn't work
+// with LASER_USART.  A follower that doesn't hear from the leader for
+// `follower_timeout` ms ends its effect.
+constexpr auto sync_role = SyncBus::STANDALONE;
+constexpr long serial_baud = 9600;
+constexpr unsigned long follower_timeout = 2000;
+SyncBus sync_bus(sync_role, serial_baud);
+
+#if LASER_USART
+// Once the laser has the USART, nothing may write to Serial.  The
+// console and frame stream just go quiet, but the sync bus and the
+// audio debug log would write on their own.  See usartlaser.h.
+static_assert(sync_role == SyncBus::STANDALONE,
+              "The sync bus needs the serial port, which LASER_USART gives to the laser.");
+static_assert(!SoundFX::LOGS_TRAFFIC,
+              "The audio debug log needs the serial port, which LASER_USART gives to the laser.");
+#endif
+unsigned long last_beat = 0;
+
+// Identifies the current effect on the sync bus.
+uint8_t effect_animation = 0;
+uint16_t effect_seed = 0;
+unsigned long effect_start = 0;
+
 // Since there are two pulses per revolution, we need to ignore
 // every other pulse.  `half_rev` is a toggle used by the fan
 // pulse interrupt service routine to skip every other pulse.
 // The variable could be function static, but that generates
-// slower code.  It does not have to be volatile because it's
-// used only in the ISR.  (If you need to sync to revolutions,
-// see `rev_flag` below.
-bool half_rev = false;
+// slower code.  It's volatile because `monitorFan` flips it back
+// when a missed pulse puts it out of phase.  (If you need to sync
+// to revolutions, see `rev_flag` below.
+volatile bool half_rev = false;
 
 // Each time a new revolution begins, the ISR sets `rev_flag`.
 // An animation can watch for this flag to kick off a new frame
@@ -70,30 +217,88 @@ bool half_rev = false;
 // high again at the beginning of the next revolution.
 volatile bool rev_flag = false;
 
+// The time (in microseconds) when the current revolution began, for
+// regulating and monitoring the fan speed.
+volatile unsigned long rev_start = 0;
+
 // Re-align the pixel clock and the pattern scanning to the
 // beginning of each revolution.
 void fanPulseISR() {
   half_rev = !half_rev;
   if (half_rev) return;
   rev_flag = true;
-  pixel_clock.resync();  // keep the pixel clock aligned with revolutions
+#if LASER_USART
   pattern.resync();
+#else
+  // Keep the pixel clock aligned with revolutions (and half a pixel
+  // behind for the odd field of an interlaced pattern).
+  pixel_clock.resync(pattern.resync());
+#endif
+  rev_start = micros();
+}
+
+#if AUDIO_INPUT
+// The sampler lets the pixel clock ISR interrupt it.  Keep the
+// ISR_NOBLOCK:  it puts the `sei` before the register saves (see
+// audioinput.h).
+ISR(ADC_vect, ISR_NOBLOCK) { audio_input.sample(ADCH); }
+#endif
+
+// The crash handlers, for WDT_vect and failed assertions (see
+// failsafe.h).  Interrupts stay off throughout:  `rev_start` is four
+// bytes, and the fan ISR must not change it halfway through the copy.
+void killOutputs() {
+  laser.kill();
+  fog_pin.clear();
+}
+
+void crash() { crashReset(static_cast<uint8_t>(state), rev_start); }
+
+// The loop stopped feeding the watchdog.  Make everything safe and
+// restart.
+ISR(WDT_vect) {
+  killOutputs();
+  crash();
 }
 
+#if LASER_USART
+// The USART finished shifting out a byte, so give it the next eight.
+ISR(USART_TX_vect) { laser.shift(pattern.scanByte()); }
+#else
+#if PROFILE_PIXEL_ISR
+volatile uint16_t pixel_latency_min = 0xFFFF;
+volatile uint16_t pixel_latency_max = 0;
+#endif
+
 // This is the pixel clock ISR.
-ISR(TIMER2_COMPA_vect) {
+ISR(TIMER1_COMPA_vect) {
+#if PROFILE_PIXEL_ISR
+  // The counter restarted from 0 at the compare match, so it tells us
+  // how long it took to get here.  The pixel clock always uses a
+  // prescaler of 1 at our frequencies, so these are CPU cycles.
+  const uint16_t latency = TCNT1;
+  if (latency < pixel_latency_min) pixel_latency_min = latency;
+  if (latency > pixel_latency_max) pixel_latency_max = latency;
+#endif
   if (pattern.scan()) {
     laser.on();
   } else {
     laser.off();
   }
 }
+#endif
 
 [[noreturn]] void emergencyStop() {
+  // Stopping is deliberate, so don't let the watchdog restart us.
+  stopWatchdog();
   noInterrupts();
   laser.disable();
   fan.stop();
+#if LASER_USART
+  laser.stop(serial_baud);
+#else
   pixel_clock.stop();
+#endif
   interrupts();
   soundfx.play(SoundFX::EMERGENCY);
   fog_pin.clear();
@@ -120,18 +325,69 @@ ISR(TIMER2_COMPA_vect) {
   }
 }
 
-void beginEffect() {
-  animator.setAnimation(animations[animation_index]);
+// While idle, the pattern is blank, so there's no need to wake up
+// for every pixel.
+void pausePixels() {
+#if !LASER_USART
+  pixel_clock.pause();
+  laser.off();  // in case the last pixel was lit
+#endif
+}
+
+void resumePixels() {
+#if !LASER_USART
+  pixel_clock.resume();
+#endif
+}
+
+void nextAnimation() {
+  animator.transitionTo(animations[animation_index], pattern,
+                        transitions[transition_index], transition_length);
+  transition_index = (transition_index + 1) % (sizeof(transitions) / sizeof(transitions[0]));
   animation_index = (animation_index + 1) % (sizeof(animations) / sizeof(animations[0]));
+}
+
+void sendBeat(bool animating) {
+  const SyncBus::Beat beat = {
+    animating, effect_animation, effect_seed,
+    static_cast<uint16_t>(animator.frame()), millis() - effect_start
+  };
+  sync_bus.send(Serial, beat);
+}
+
+// Returns the effect time (ms) selected by the pot (or the console).
+long effectTime() {
+  if (effect_time_override != 0) return effect_time_override;
+  return map(audio_input.read(effect_time_pin), 1023, 0, 3, 30)*1000;
+}
+
+// Returns the percentage of the effect to run the fog.
+long fogDuty() {
+  if (fog_duty_override >= 0) return fog_duty_override;
+  return map(audio_input.read(effect_time_pin), 1023, 0, 0, 100);
+}
+
+// Starts an effect with the given animation and random seed as if it
+// had begun `elapsed` ms ago.  Followers use these to match the leader.
+void beginEffect(uint8_t animation, uint16_t seed, unsigned long elapsed = 0) {
+  effect_animation = animation;
+  effect_seed = seed;
+  rng.seed(seed);
+  animation_index = animation % (sizeof(animations) / sizeof(animations[0]));
+  resumePixels();
+  nextAnimation();
+  effect_start = millis() - elapsed;
+  cues.start(effect_start);
+  sendBeat(true);
 
   const auto audio_duration = soundfx.duration(SoundFX::STARTLE);
   if (audio_duration != 0) {
     // We know how long to run the effect to match the audio track,
     // so the Effect Time pot tells us the duty cycle for the fog.
-    const auto fog_duty =
-      map(analogRead(effect_time_pin), 1023, 0, 0, 100);
-    fog_pin.set();
-    fog_timeout.set(fog_duty * audio_duration / 100);
+    const auto fog_duty = fogDuty();
+    cues.load(startle_cues, audio_duration);
+    cues.schedule(fog_duty * audio_duration / 100, CUE_FOG_OFF);
+    awaiting_end_cue = true;
     soundfx.play(SoundFX::STARTLE);
     state = State::Animating;
     return;
@@ -139,13 +395,14 @@ void beginEffect() {
 
   if (soundfx.has(SoundFX::STARTLE)) {
     // The effect will run for the duration of the audio track,
-    // but we don't know how long that will be.  We'll run the
-    // fog for the duration indicated by the Effect Time pot.
-    // (If the audio completes sooner, we'll stop the fog then.)
-    fog_pin.set();
-    const auto fog_duration =
-      map(analogRead(effect_time_pin), 1023, 0, 3, 30)*1000;
-    fog_timeout.set(fog_duration);
+    // but we don't know how long that will be, so we can't use
+    // a cue list.  We'll run the fog for the duration indicated
+    // by the Effect Time pot.  (If the audio completes sooner,
+    // we'll stop the fog then.)
+    const auto fog_duration = effectTime();
+    cues.schedule(0, CUE_FOG_ON);
+    cues.schedule(fog_duration, CUE_FOG_OFF);
+    awaiting_end_cue = false;
     soundfx.play(SoundFX::STARTLE);
     state = State::Animating;
     return;
@@ -154,90 +411,401 @@ void beginEffect() {
   // There's no audio, so the Effect Time pot tells us how
   // long to animate, and we'll blast fog for the first half
   // of that (up to 1 minute).
-  const auto effect_duration =
-    map(analogRead(effect_time_pin), 1023, 0, 3, 30)*1000;
-  effect_timeout.set(effect_duration);
-  fog_pin.set();
+  const auto effect_duration = effectTime();
+  cues.load(silent_cues, effect_duration);
   const auto fog_duration = min(effect_duration/2, 60000);
-  fog_timeout.set(fog_duration);
+  cues.schedule(fog_duration, CUE_FOG_OFF);
+  awaiting_end_cue = true;
   state = State::Animating;
 }
 
+void beginEffect() { beginEffect(animation_index, rng.next()); }
+
+void runCue(const Cue &cue) {
+  switch (cue.action) {
+    case CUE_END:        awaiting_end_cue = false; break;
+    case CUE_FOG_ON:     fog_pin.set(); break;
+    case CUE_FOG_OFF:    fog_pin.clear(); break;
+    case CUE_LIGHTS_ON:  house_lights_pin.set(); break;
+    case CUE_LIGHTS_OFF: house_lights_pin.clear(); break;
+    case CUE_ANIMATION:
+      if (cue.arg < sizeof(animations) / sizeof(animations[0])) {
+        animation_index = cue.arg;
+      }
+      nextAnimation();
+      break;
+    case CUE_SOUND:
+      soundfx.play(static_cast<SoundFX::Track>(cue.arg));
+      break;
+    default: break;
+  }
+}
+
 void endEffect() {
+  sendBeat(false);
+  cues.clear();
+  awaiting_end_cue = false;
   fog_pin.clear();
-  fog_timeout.cancel();
-  effect_timeout.cancel();
+  house_lights_pin.clear();
+  animator.setAnimation(nullptr);
   pattern.clear();
+  exposure.reset(pattern);
+  pausePixels();
   soundfx.play(SoundFX::AMBIENT);
   state = State::Idle;
 }
 
+void endStreaming() {
+  animator.setAnimation(nullptr);
+  pattern.clear();
+  exposure.reset(pattern);
+  pausePixels();
+  state = State::Idle;
+}
+
+// The pixel clock no longer matches the fan, so gate the laser right
+// away, and then measure the fan again.
+void recalibrate() {
+  laser.disable();
+#if LASER_USART
+  // This also gives the serial port back, so it's safe to print again.
+  laser.stop(serial_baud);
+#else
+  pixel_clock.stop();
+#endif
+  if (state == State::Animating) endEffect();
+  if (state == State::Streaming) endStreaming();
+  state = State::Calibrating;
+  fan.spinUp();
+  calibrator.begin(fan);
+}
+
+// Prints a report a line at a time, like a console command, so it
+// doesn't stall the loop on the serial port.  See the definition below.
+void report(CommandHandler steps);
+
+FanMonitor::Fault fan_fault = FanMonitor::NONE;
+
+// The report after a fan fault, a line per step.
+bool fanFaultReport(const char *, uint8_t step) {
+  switch (step) {
+    case 0:
+      Serial.print(F("Fan fault: "));
+      FanMonitor::printFaultName(fan_fault);
+      Serial.println();
+      return true;
+    case 1: fan_monitor.printPeriods(); return true;
+    case 2: fan_monitor.printRange(); return true;
+    default: fan_monitor.printCounts(); return false;
+  }
+}
+
+// The report after a calibration, a line per step.
+bool calibrationReport(const char *, uint8_t step) {
+  return calibrator.printReport(step, pattern.size());
+}
+
+// Feeds the fan speed controller once per revolution, and recalibrates
+// if the fan monitor detects a problem.
+void monitorFan() {
+  noInterrupts();
+  const auto start = rev_start;
+  interrupts();
+  if (fan_monitor.update(start, micros())) {
+    fan.regulate(fan_monitor.lastPeriod());
+  }
+  if (fan_monitor.slipped()) {
+    // The ISR is starting revolutions at the wrong tach pulse.
+    noInterrupts();
+    half_rev = !half_rev;
+    interrupts();
+  }
+  if (fan_monitor.fault() != FanMonitor::NONE) {
+    fan_fault = fan_monitor.fault();
+    // Recalibrating stops the output first, which frees the serial
+    // port if the laser had it.
+    recalibrate();
+    report(fanFaultReport);
+  }
+}
+
 void setup() {
-  Serial.begin(9600);
+  setCrashHandlers(killOutputs, crash);
+  startup.begin(BOOT_READY);
+  startup.begin(BOOT_SETUP);
+  // After a crash, we may be able to skip the slow parts.
+  Calibration calibration;
+  const bool warm = checkRestart(calibration);
+  Serial.begin(serial_baud);
   Serial.println(F("\nLaser Tunnel V1"));
   Serial.println(F("Copyright 2022 Adrian McCarthy"));
   Serial.println(F("https://github.com/aidtopia/laser_tunnel"));
+  if (lastCrash().reason != CRASH_NONE) {
+    Serial.print(warm ? F("Warm start after: ") : F("Cold start after: "));
+    printCrash(lastCrash());
+  }
+
+  if (!warm) {
+    startup.begin(BOOT_SELF_TEST);
+#if SELF_TEST
+    checkAnimations();
+#endif
+#if BENCHMARK
+    benchmarkPolar();
+    benchmarkTransitions();
+#endif
+    startup.end(BOOT_SELF_TEST);
+  }
+  // Seed after the self-test, which uses a fixed seed.
+  rng.seedFromNoise(effect_time_pin);
+#if AUDIO_INPUT
+  audio_input.begin(audio_pin);
+#endif
 
   status_pin.begin(LOW);
   laser.begin();
   fan.begin();
-  soundfx.begin();
+  if (!warm) startup.begin(BOOT_AUDIO_RESET);
+  soundfx.begin(warm);
   fog_pin.begin(LOW);
   house_lights_pin.begin(LOW);
 
   emergency_stop.begin(INPUT_PULLUP);
   suppressor.begin();
   trigger.begin();
+  idler.begin();
 
+  if (warm) fan_target_rpm = calibration.rpm;
+  fan.setTargetRPM(fan_target_rpm);
   state = State::Calibrating;
-  calibrator.begin(fan);
+  startup.begin(BOOT_CALIBRATION);
+  if (warm) {
+    calibrator.resume(fan, calibration.fan_period, calibration.duty);
+  } else {
+    calibrator.begin(fan);
+  }
+  printMemory();
+  startup.end(BOOT_SETUP);
+  startWatchdog();
 }
 
-void loop() {
-  if (emergency_stop.read() == LOW) emergencyStop();
-  suppressor.update(laser);
+// The sketch's side of SyncBus::follow.
+struct FollowedEffect {
+  bool running() const { return state == State::Animating; }
+  uint8_t animation() const { return effect_animation; }
+  uint16_t seed() const { return effect_seed; }
+  unsigned long start() const { return effect_start; }
+  unsigned frame() const { return animator.frame(); }
+  void begin(uint8_t animation, uint16_t seed, unsigned long elapsed) {
+    beginEffect(animation, seed, elapsed);
+  }
+  void end() { endEffect(); }
+  void shift(long error) {
+    effect_start -= error;
+    cues.shift(error);
+  }
+  void nudge(int frames) { animator.nudge(frames); }
+};
+
+// Joins, adjusts, or ends the effect to match a beat from the leader.
+void followBeat() {
+  if (state != State::Idle && state != State::Animating) return;
+  last_beat = millis();
+  FollowedEffect effect;
+  sync_bus.follow(effect, millis());
+}
+
+// Console commands.  See the definitions below.
+bool helpCommand(const char *args, uint8_t step);
+bool statsCommand(const char *args, uint8_t step);
+bool resetCommand(const char *args, uint8_t step);
+bool getCommand(const char *args, uint8_t step);
+bool setCommand(const char *args, uint8_t step);
+bool animCommand(const char *args, uint8_t step);
+bool triggerCommand(const char *args, uint8_t step);
+bool endCommand(const char *args, uint8_t step);
+bool recalCommand(const char *args, uint8_t step);
+bool soundsCommand(const char *args, uint8_t step);
+bool memCommand(const char *args, uint8_t step);
+bool bootCommand(const char *args, uint8_t step);
+bool crashCommand(const char *args, uint8_t step);
+const char help_name[] PROGMEM = "help";
+const char query_name[] PROGMEM = "?";
+const char stats_name[] PROGMEM = "stats";
+const char reset_name[] PROGMEM = "reset";
+const char get_name[] PROGMEM = "get";
+const char set_name[] PROGMEM = "set";
+const char anim_name[] PROGMEM = "anim";
+const char trigger_name[] PROGMEM = "trigger";
+const char end_name[] PROGMEM = "end";
+const char recal_name[] PROGMEM = "recal";
+const char sounds_name[] PROGMEM = "sounds";
+const char mem_name[] PROGMEM = "mem";
+const char boot_name[] PROGMEM = "boot";
+const char crash_name[] PROGMEM = "crash";
+const Command commands[] PROGMEM = {
+  { help_name,    helpCommand },
+  { query_name,   statsCommand },
+  { stats_name,   statsCommand },
+  { reset_name,   resetCommand },
+  { get_name,     getCommand },
+  { set_name,     setCommand },
+  { anim_name,    animCommand },
+  { trigger_name, triggerCommand },
+  { end_name,     endCommand },
+  { recal_name,   recalCommand },
+  { sounds_name,  soundsCommand },
+  { mem_name,     memCommand },
+  { boot_name,    bootCommand },
+  { crash_name,   crashCommand }
+};
+Console<sizeof(commands)/sizeof(commands[0])> console(commands);
+
+void report(CommandHandler steps) {
+#if LASER_USART
+  // The laser may be about to take the serial port, so print it now.
+  // The output is stopped anyway.
+  for (uint8_t step = 0; steps("", step); ++step) {}
+#else
+  console.report(steps);
+#endif
+}
+
+// Handles serial input.  Sync bus messages go to `followBeat`.  Other
+// bytes go to the frame stream and the script loader (each ignores the
+// other's messages) and to the console.
+void serialTask() {
+  // While the laser has the USART, there's no serial port to talk to.
+  if (laser.ownsUsart()) return;
+  // Give up on a stalled message before reading what came after it.
+  const auto available = Serial.available();
+  frame_stream.update(available);
+  script_loader.update(available);
+  for (auto i = available; i > 0; --i) {
+    const auto b = static_cast<uint8_t>(Serial.read());
+    if (frame_stream.busy()) { frame_stream.receive(b); continue; }
+    if (script_loader.busy()) { script_loader.receive(b); continue; }
+    const auto status = sync_bus.receive(b);
+    if (status == SyncBus::READY) followBeat();
+    if (status != SyncBus::PASS) continue;
+    frame_stream.receive(b);
+    script_loader.receive(b);
+    if (frame_stream.busy() || script_loader.busy()) {
+      // That was the start of a message, not a command.
+      console.cancel();
+      continue;
+    }
+    console.receive(b);
+  }
+  console.update();
+}
+
+void soundfxTask() {
   soundfx.update();
-  
+  if (soundfx.initialized()) startup.end(BOOT_AUDIO_RESET);
+  if (soundfx.fileCount() != 0) startup.end(BOOT_AUDIO_FILES);
+  else if (soundfx.initialized()) startup.begin(BOOT_AUDIO_FILES);
+}
+
+// After this long (ms) without a crash, a crash gets warm starts again.
+constexpr unsigned long healthy_time = 60000;
+
+void fanTask() {
+  if (state == State::Idle || state == State::Animating ||
+      state == State::Streaming) {
+    monitorFan();
+    if (millis() > healthy_time) markHealthy();
+  }
+}
+
+void stateTask() {
   switch (state) {
     case State::Calibrating:
       if (calibrator.update()) {
         const auto period = calibrator.fanPeriod();
         const auto pixel_freq =
           calibrator.pixelFrequency(period, pattern.size());
+        report(calibrationReport);
+        saveCalibration({ period, static_cast<uint16_t>(fan_target_rpm), fan.duty() });
+        // Report before starting the output, which may take the
+        // serial port (see usartlaser.h).
+        if (!startup.done(BOOT_READY)) {
+          startup.end(BOOT_CALIBRATION);
+          startup.end(BOOT_READY);
+          Serial.print(F("Ready after "));
+          Serial.print(startup.duration(BOOT_READY));
+          Serial.println(F(" ms (see `boot`)"));
+          if (lastCrash().reason != CRASH_NONE) {
+            // millis() started over at the reset.  The pixels stay
+            // paused until the next effect, so this is when the tunnel
+            // could run again, not when the laser came back on.
+            Serial.print(F("Ready again within "));
+            Serial.print(crashLatency(lastCrash()) + millis());
+            Serial.println(F(" ms of the fault (see `crash`)"));
+          }
+        }
+#if LASER_USART
+        laser.start(pixel_freq);
+#else
         pixel_clock.begin(pixel_freq);
+#endif
 
         // Once the pixel clock is started, we can run the fan
         // with its usual ISR.
         fan.run(fanPulseISR);
+        noInterrupts();
+        const auto start = rev_start;
+        interrupts();
+        fan_monitor.begin(period, start, micros());
+
+        // If we're recovering from a fan fault, the laser was
+        // disabled.  Let the suppressor decide if it should stay off.
+        if (!suppressor.active()) laser.enable();
 
         // By now, the soundfx module should be ready.
         soundfx.play(SoundFX::AMBIENT);
 
+        pausePixels();
         state = State::Idle;
       }
       break;
 
     case State::Idle:
-      if (trigger.read()) {
+      // Followers wait for the leader instead of the trigger.
+      if (sync_role != SyncBus::FOLLOWER && trigger.read()) {
         beginEffect();
         break;
       }
+      if (frame_stream.pending()) {
+        resumePixels();
+        animator.setAnimation(Streamed);
+        state = State::Streaming;
+        break;
+      }
       if (soundfx.currentTrack() == SoundFX::NONE && soundfx.has(SoundFX::AMBIENT)) {
         soundfx.play(SoundFX::AMBIENT);
       }
       break;
 
     case State::Animating: {
-      animator.update(rev_flag, pattern);
+      audio_input.update();
+      if (animator.update(rev_flag, pattern)) {
+        exposure.update(pattern);
+        if (animator.frame() % SyncBus::BEAT_FRAMES == 0) sendBeat(true);
+      }
+
+      Cue cue;
+      while (cues.poll(millis(), cue)) runCue(cue);
 
-      if (fog_timeout.expired()) {
-        fog_pin.clear();
-        fog_timeout.cancel();
+      if (sync_role == SyncBus::FOLLOWER) {
+        // The leader decides when the effect ends, unless it's gone quiet.
+        if (millis() - last_beat > follower_timeout) endEffect();
+        break;
       }
 
       if (soundfx.currentTrack() == SoundFX::STARTLE) break;
 
-      if (effect_timeout.active() && !effect_timeout.expired()) break;
+      if (awaiting_end_cue) break;
       
       if (trigger.read()) {
         // Don't bother going idle, just run another round.
@@ -249,10 +817,286 @@ void loop() {
       break;
     }
     
+    case State::Streaming:
+      if (animator.update(rev_flag, pattern)) exposure.update(pattern);
+      if (!frame_stream.pending() &&
+          millis() - frame_stream.lastFrameTime() > stream_timeout) {
+        endStreaming();
+      }
+      break;
+
     default:
-      Serial.print(F("Laser Tunnel in unexpected state: "));
-      Serial.println(static_cast<int>(state));
+      if (!laser.ownsUsart()) {
+        Serial.print(F("Laser Tunnel in unexpected state: "));
+        Serial.println(static_cast<int>(state));
+      }
       emergencyStop();
       break;
   }
 }
+
+// Budgets are in microseconds.
+const char suppressor_name[] PROGMEM = "suppressor";
+const char soundfx_name[] PROGMEM = "soundfx";
+const char serial_name[] PROGMEM = "serial";
+const char fan_name[] PROGMEM = "fan";
+const char state_name[] PROGMEM = "state";
+Task suppressor_task(suppressor_name, [](){ suppressor.update(laser); }, 0, 200);
+Task soundfx_task(soundfx_name, soundfxTask, 0, 500);
+Task serial_task(serial_name, serialTask, 0, 500);
+Task fan_task(fan_name, fanTask, 0, 200);
+Task state_task(state_name, stateTask, 0, 2000);
+Task *tasks[] = {
+  &suppressor_task, &soundfx_task, &serial_task, &fan_task, &state_task
+};
+Scheduler<sizeof(tasks)/sizeof(tasks[0])> scheduler(tasks);
+
+constexpr uint8_t task_count = sizeof(tasks)/sizeof(tasks[0]);
+constexpr uint8_t animation_count = sizeof(animations)/sizeof(animations[0]);
+
+// Prints the command names, one per step.
+bool helpCommand(const char *, uint8_t step) {
+  return console.printCommand(step);
+}
+
+// Prints a line of statistics per step.
+bool statsCommand(const char *, uint8_t step) {
+  if (step < task_count) {
+    tasks[step]->printStatistics();
+    return true;
+  }
+  switch (step - task_count) {
+    case 0:
+      Serial.print(F("Worst pass: "));
+      Serial.print(scheduler.worstPass());
+      Serial.println(F(" us"));
+      return true;
+    case 1: fan_monitor.printPeriods(); return true;
+    case 2: fan_monitor.printRange(); return true;
+    case 3: fan_monitor.printCounts(); return true;
+    case 4: idler.printStatistics(); return true;
+    case 5: exposure.printStatistics(); return true;
+    case 6: frame_stream.printFrames(); return true;
+#if PROFILE_PIXEL_ISR
+    case 7: {
+      noInterrupts();
+      const auto latency_min = pixel_latency_min;
+      const auto latency_max = pixel_latency_max;
+      pixel_latency_min = 0xFFFF;
+      pixel_latency_max = 0;
+      interrupts();
+      Serial.print(F("Pixel ISR latency: "));
+      Serial.print(latency_min);
+      Serial.print(F(" to "));
+      Serial.print(latency_max);
+      Serial.println(F(" cycles"));
+      return true;
+    }
+#endif
+    default: frame_stream.printErrors(); return false;
+  }
+}
+
+bool resetCommand(const char *, uint8_t) {
+  scheduler.resetStatistics();
+  idler.resetStatistics();
+  Serial.println(F("Statistics reset"));
+  return false;
+}
+
+// Runtime parameters for `get` and `set`.
+const char rpm_param[] PROGMEM = "rpm";
+const char effect_param[] PROGMEM = "effect";
+const char fog_param[] PROGMEM = "fog";
+const char limit_param[] PROGMEM = "limit";
+const char fade_param[] PROGMEM = "fade";
+const char *const params[] PROGMEM = {
+  rpm_param, effect_param, fog_param, limit_param, fade_param
+};
+constexpr uint8_t param_count = sizeof(params)/sizeof(params[0]);
+
+// Returns the index of the named parameter, or param_count.
+uint8_t findParam(const char *name) {
+  uint8_t i = 0;
+  while (i < param_count &&
+         strcmp_P(name, static_cast<const char *>(pgm_read_ptr(&params[i]))) != 0) {
+    ++i;
+  }
+  return i;
+}
+
+long getParam(uint8_t i) {
+  switch (i) {
+    case 0:  return fan_target_rpm;
+    case 1:  return effect_time_override;
+    case 2:  return fog_duty_override;
+    case 3:  return exposure.limit();
+    case 4:  return transition_length;
+    default: return 0;
+  }
+}
+
+bool setParam(uint8_t i, long value) {
+  switch (i) {
+    case 0:
+      if (value < 0 || 10000 < value) return false;
+      fan_target_rpm = value;
+      fan.setTargetRPM(fan_target_rpm);
+      // The pixel clock has to match the new speed.
+      if (state == State::Idle || state == State::Animating ||
+          state == State::Streaming) {
+        recalibrate();
+      }
+      return true;
+    case 1:
+      if (value < 0 || 600000L < value) return false;
+      effect_time_override = value;
+      return true;
+    case 2:
+      if (value < -1 || 100 < value) return false;
+      fog_duty_override = value;
+      return true;
+    case 3:
+      if (value < 0 || 100 < value) return false;
+      exposure.setLimit(value);
+      return true;
+    case 4:
+      if (value < 0 || 255 < value) return false;
+      transition_length = value;
+      return true;
+    default:
+      return false;
+  }
+}
+
+void printParam(uint8_t i) {
+  Serial.print(reinterpret_cast<const __FlashStringHelper *>(
+    pgm_read_ptr(&params[i])));
+  Serial.print('=');
+  Serial.println(getParam(i));
+}
+
+// `get` prints one parameter, or all of them, one per step.
+bool getCommand(const char *args, uint8_t step) {
+  char name[8];
+  if (console.nextWord(args, name, sizeof(name)) == nullptr) {
+    printParam(step);
+    return step + 1 < param_count;
+  }
+  const auto i = findParam(name);
+  if (i == param_count) {
+    Serial.println(F("Parameters: rpm effect fog limit fade"));
+    return false;
+  }
+  printParam(i);
+  return false;
+}
+
+bool setCommand(const char *args, uint8_t) {
+  char name[8];
+  long value = 0;
+  args = console.nextWord(args, name, sizeof(name));
+  const auto i = args ? findParam(name) : param_count;
+  if (i == param_count || console.nextNumber(args, value) == nullptr) {
+    Serial.println(F("Usage: set rpm|effect|fog <value>"));
+    return false;
+  }
+  if (!setParam(i, value)) {
+    Serial.println(F("Out of range"));
+    return false;
+  }
+  printParam(i);
+  return false;
+}
+
+// Switches to an animation now, if an effect is running, or else
+// chooses the one the next effect will start with.
+bool animCommand(const char *args, uint8_t) {
+  long index = 0;
+  if (console.nextNumber(args, index) == nullptr ||
+      index < 0 || animation_count <= index) {
+    Serial.print(F("Usage: anim 0-"));
+    Serial.println(animation_count - 1);
+    return false;
+  }
+  animation_index = index;
+  if (state == State::Animating) nextAnimation();
+  Serial.print(F("Animation "));
+  Serial.println(index);
+  return false;
+}
+
+bool triggerCommand(const char *, uint8_t) {
+  if (state != State::Idle && state != State::Animating) {
+    Serial.println(F("Not ready"));
+    return false;
+  }
+  beginEffect();
+  return false;
+}
+
+bool endCommand(const char *, uint8_t) {
+  if (state == State::Animating) endEffect();
+  if (state == State::Streaming) endStreaming();
+  return false;
+}
+
+bool recalCommand(const char *, uint8_t) {
+  if (state != State::Idle && state != State::Animating &&
+      state != State::Streaming) {
+    Serial.println(F("Not ready"));
+    return false;
+  }
+  Serial.println(F("Recalibrating"));
+  recalibrate();
+  return false;
+}
+
+bool memCommand(const char *, uint8_t) {
+  printMemory();
+  return false;
+}
+
+// Prints the startup profile, a phase per step.
+bool bootCommand(const char *, uint8_t step) {
+  startup.printPhase(static_cast<StartupPhase>(step));
+  return step + 1 < BOOT_PHASE_COUNT;
+}
+
+// Shows why the last reset happened, if it was a crash, in two steps.
+bool crashCommand(const char *, uint8_t step) {
+  if (step == 0) {
+    printCrashReason(lastCrash());
+    return true;
+  }
+  printCrashTime(lastCrash());
+  return false;
+}
+
+// Shows what the SoundFX module knows about each track, one per step.
+bool soundsCommand(const char *, uint8_t step) {
+  const auto track = static_cast<SoundFX::Track>(SoundFX::STARTLE + step);
+  switch (track) {
+    case SoundFX::STARTLE:   Serial.print(F("startle: ")); break;
+    case SoundFX::AMBIENT:   Serial.print(F("ambient: ")); break;
+    case SoundFX::EMERGENCY: Serial.print(F("emergency: ")); break;
+    default: break;
+  }
+  if (!soundfx.has(track)) {
+    Serial.println(F("missing"));
+  } else if (soundfx.duration(track) == 0) {
+    Serial.println(F("length unknown"));
+  } else {
+    Serial.print(soundfx.duration(track));
+    Serial.println(F(" ms"));
+  }
+  return track + 1 < SoundFX::SLOTS;
+}
+
+void loop() {
+  feedWatchdog();
+  // The emergency stop isn't a task, so nothing can delay it.
+  if (emergency_stop.read() == LOW) emergencyStop();
+  scheduler.run();
+  idler.sleep();
+}
@@ -0,0 +1,65 @@
+#include <Arduino.h>
+#include "memory.h"
+
+// Symbols provided by the linker and avr-libc.
+extern uint8_t __data_start;
+extern uint8_t _end;
+extern uint8_t __stack;
+extern char *__brkval;
+
+namespace {
+
+constexpr uint8_t CANARY = 0xC5;
+
+}
+
+// This runs in .init1, before the stack pointer is set up and before
+// the zero register is cleared, so it's written in assembly and uses
+// only scratch registers.
+void paintStack() __attribute__((naked, used, section(".init1")));
+void paintStack() {
+  __asm volatile (
+    "    ldi r30, lo8(_end)\n"
+    "    ldi r31, hi8(_end)\n"
+    "    ldi r24, %0\n"
+    "    ldi r25, hi8(__stack)\n"
+    "    rjmp 2f\n"
+    "1:  st Z+, r24\n"
+    "2:  cpi r30, lo8(__stack)\n"
+    "    cpc r31, r25\n"
+    "    brlo 1b\n"
+    "    breq 1b\n"
+    :
+    : "i" (CANARY)
+  );
+}
+
+uint16_t staticRam() {
+  return static_cast<uint16_t>(&_end - &__data_start);
+}
+
+uint16_t freeRam() {
+  uint8_t top;  // the address of a local approximates the stack pointer
+  const auto bottom = __brkval != nullptr ? reinterpret_cast<uint8_t *>(__brkval) : &_end;
+  return static_cast<uint16_t>(&top - bottom);
+}
+
+uint16_t unusedStack() {
+  const uint8_t *p = &_end;
+  if (__brkval != nullptr) p = reinterpret_cast<const uint8_t *>(__brkval);
+  uint16_t count = 0;
+  while (p <= &__stack && *p == CANARY) {
+    ++p;
+    ++count;
+  }
+  return count;
+}
+
+void printMemory() {
+  Serial.print(F("RAM: static="));
+  Serial.print(staticRam());
+  Serial.print(F(", free="));
+  Serial.print(freeRam());
+  Serial.print(F(", never used="));
+  Serial.println(unusedStack());
+}
@@ -0,0 +1,36 @@
+// Memory instrumentation
+// Adrian McCarthy 2022
+
+// The ATmega328P has just 2 KB of SRAM.  The static data (.data and
+// .bss) sits at the bottom, the heap (which we don't use) grows up
+// from the end of the static data, and the stack grows down from the
+// top.  If they ever meet, things go wrong in mysterious ways.
+//
+// At startup, before any constructors run, memory.cpp paints all of
+// the RAM between the static data and the stack with a canary value.
+// The stack overwrites the canaries as it grows, so counting the
+// ones that remain tells how close the stack has ever come to the
+// static data (the high-water mark).
+//
+// For a breakdown of RAM and flash by symbol, see
+// code/tools/footprint.py.
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <Arduino.h>
+
+// Bytes of RAM used by static data (.data and .bss).
+uint16_t staticRam();
+
+// Bytes between the top of the heap (or static data) and the stack
+// pointer right now.
+uint16_t freeRam();
+
+// Bytes at the bottom of the free space that the stack has never
+// touched.  This takes a few hundred microseconds.
+uint16_t unusedStack();
+
+void printMemory();
+
+#endif
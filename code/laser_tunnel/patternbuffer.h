@@ -3,27 +3,202 @@
 
 // The PatternBuffer is a bitmask for 256 "pixels" mapped
 // around the cone of the laser tunnel.
+//
+// An InterlacedPatternBuffer (below) adds a second field of 256
+// pixels.  Revolutions alternate between the fields, and the pixel
+// clock runs half a pixel late for the odd field, so together they
+// give 512 positions around the cone for the same interrupt rate.
+// The fine pixel functions address all 512:  fine pixel 2i is pixel i
+// of the even field, and 2i + 1 is pixel i of the odd field.  All the
+// other functions work on whole pixels and apply to both fields, so
+// animations that don't know about interlacing look the same as
+// before.  In a buffer without an odd field, the fine pixel functions
+// fall back to the whole pixel, so an animation can draw fine pixels
+// into any buffer.
 
 class PatternBuffer {
   public:
-    PatternBuffer() : m_buffer(), m_scan_index(0), m_scan_start(0) {}
+    PatternBuffer() : PatternBuffer(nullptr) {}
 
-    void clear() { for (auto &b : m_buffer) b = 0; }
+    // Since the scan keeps a pointer into the buffer, use `copy`
+    // instead.
+    PatternBuffer(const PatternBuffer &) = delete;
+    PatternBuffer &operator=(const PatternBuffer &) = delete;
+
+    void clear() { forEachByte([](uint8_t &b) { b = 0; }); }
     constexpr size_t size() { return 8*sizeof(m_buffer); }
     bool operator[](int i) const {
       const auto index = static_cast<uint8_t>(i);
       return (b(index) & mask(index)) != 0;
     }
-    void setPixel(uint8_t i)    { b(i) |=  mask(i); }
-    void clearPixel(uint8_t i)  { b(i) &= ~mask(i); }
-    void togglePixel(uint8_t i) { b(i) ^=  mask(i); }
+    void setPixel(uint8_t i)    { modify(i >> 3, mask(i), [](uint8_t &b, uint8_t m) { b |=  m; }); }
+    void clearPixel(uint8_t i)  { modify(i >> 3, mask(i), [](uint8_t &b, uint8_t m) { b &= ~m; }); }
+    void togglePixel(uint8_t i) { modify(i >> 3, mask(i), [](uint8_t &b, uint8_t m) { b ^=  m; }); }
+
+    // Fine pixels are numbered 0 through fineSize() - 1.
+    bool interlaced() const { return m_odd != nullptr; }
+    constexpr uint16_t fineSize() { return 2*size(); }
+    bool fine(uint16_t i) const { return (fineByte(i) & fineMask(i)) != 0; }
+    void setFinePixel(uint16_t i)    { fineByte(i) |=  fineMask(i); }
+    void clearFinePixel(uint16_t i)  { fineByte(i) &= ~fineMask(i); }
+    void toggleFinePixel(uint16_t i) { fineByte(i) ^=  fineMask(i); }
 
     void setTestPattern() {
-      for (auto &b : m_buffer) b = 0b11110000;
+      forEachByte([](uint8_t &b) { b = 0b11110000; });
+    }
+
+    // The bulk operations work on eight pixels at a time, so they
+    // are much cheaper than looping over the individual pixels.
+    // Ranges wrap around from the last pixel to the first.
+    void setRange(uint8_t first, uint16_t count) {
+      forRange(first, count, [](uint8_t &b, uint8_t m) { b |= m; });
+    }
+    void clearRange(uint8_t first, uint16_t count) {
+      forRange(first, count, [](uint8_t &b, uint8_t m) { b &= ~m; });
+    }
+    void toggleRange(uint8_t first, uint16_t count) {
+      forRange(first, count, [](uint8_t &b, uint8_t m) { b ^= m; });
+    }
+    void invert() { forEachByte([](uint8_t &b) { b = ~b; }); }
+
+    // Unlike `rotate`, which changes where the scan begins, these
+    // move the contents of the buffer.  Positive amounts move pixels
+    // toward higher indexes.  Shifting fills the vacated pixels with
+    // zeros.
+    void rotateContent(int amount) {
+      for (uint8_t f = 0; f < fields(); ++f) rotateField(field(f), amount);
+    }
+    void shiftContent(int amount) {
+      if (amount <= -256 || 256 <= amount) return clear();
+      rotateContent(amount);
+      if (amount > 0) clearRange(0, amount);
+      else if (amount < 0) clearRange(static_cast<uint8_t>(amount), -amount);
+    }
+
+    // Blend modes for combining one buffer into another.  MASK clears
+    // the pixels that are set in the source.
+    enum Blend : uint8_t { BLEND_COPY, BLEND_OR, BLEND_AND, BLEND_XOR, BLEND_MASK };
+
+    static uint8_t blend(uint8_t dst, uint8_t src, Blend op) {
+      switch (op) {
+        case BLEND_COPY: return src;
+        case BLEND_OR:   return dst | src;
+        case BLEND_AND:  return dst & src;
+        case BLEND_XOR:  return dst ^ src;
+        case BLEND_MASK: return dst & ~src;
+        default:         return dst;
+      }
+    }
+
+    // Combines `src` into this buffer.  The source is taken as it
+    // would be displayed, so its rotation is applied.
+    void combine(const PatternBuffer &src, Blend op) {
+      for (uint8_t f = 0; f < fields(); ++f) {
+        auto dst = field(f);
+        for (uint8_t k = 0; k < sizeof(m_buffer); ++k) {
+          dst[k] = blend(dst[k], src.displayedByte(k, f), op);
+        }
+      }
+    }
+
+    // Copies the pixels of `src` wherever `mask` is set, leaving
+    // the rest of this buffer alone.
+    void copyMasked(const PatternBuffer &src, const PatternBuffer &mask) {
+      for (uint8_t f = 0; f < fields(); ++f) {
+        auto dst = field(f);
+        for (uint8_t k = 0; k < sizeof(m_buffer); ++k) {
+          const uint8_t m = mask.displayedByte(k, f);
+          dst[k] = (dst[k] & ~m) | (src.displayedByte(k, f) & m);
+        }
+      }
+    }
+
+    // Byte-level access for compositing.  Byte `k` holds pixels
+    // 8*k through 8*k + 7, MSB first.  `displayedByte` accounts for
+    // the rotation.  Field 1 is the odd field, if there is one.
+    uint8_t displayedByte(uint8_t k, uint8_t f = 0) const {
+      return displayedBits(8*k, f);
+    }
+    // Like `displayedByte`, but starting at any pixel.
+    uint8_t displayedBits(uint8_t i, uint8_t f = 0) const {
+      return bitsAt(field(f), static_cast<uint8_t>(m_scan_start + i));
+    }
+    void setByte(uint8_t k, uint8_t pixels) {
+      modify(k, pixels, [](uint8_t &b, uint8_t p) { b = p; });
+    }
+    void toggleByte(uint8_t k, uint8_t pixels) {
+      modify(k, pixels, [](uint8_t &b, uint8_t p) { b ^= p; });
+    }
+    void blendByte(uint8_t k, uint8_t pixels, Blend op) {
+      k &= 0b00011111;
+      for (uint8_t f = 0; f < fields(); ++f) {
+        auto &b = field(f)[k];
+        b = blend(b, pixels, op);
+      }
+    }
+
+    // Copies the pixels and rotation of `src`.  Unlike assignment, it
+    // leaves the scan position and output mask alone, so it's safe to
+    // copy into the buffer being scanned.
+    void copy(const PatternBuffer &src) {
+      for (uint8_t f = 0; f < fields(); ++f) {
+        auto dst = field(f);
+        const auto from = src.field(f);
+        for (uint8_t k = 0; k < sizeof(m_buffer); ++k) dst[k] = from[k];
+      }
+      setRotation(src.m_scan_start);
+    }
+
+    // Returns the number of lit pixels.  For an interlaced buffer,
+    // that's the average of the two fields.
+    uint16_t countLit() const {
+      uint16_t count = 0;
+      for (uint8_t f = 0; f < fields(); ++f) {
+        const auto src = field(f);
+        for (uint8_t k = 0; k < sizeof(m_buffer); ++k) {
+          for (uint8_t b = src[k]; b != 0; ++count) {
+            b &= b - 1;  // clears the lowest set bit
+          }
+        }
+      }
+      return count / fields();
+    }
+
+    // The output mask dims the scan without changing the contents:
+    // only pixels whose position within their byte has the
+    // corresponding mask bit set are lit.  See exposure.h.
+    void setOutputMask(uint8_t mask) { m_output_mask = mask; }
+    uint8_t outputMask() const { return m_output_mask; }
+
+    bool scan() {
+      const auto i = m_scan_index++;
+      return (m_scan_field[i >> 3] & mask(i) & m_output_mask) != 0;
     }
 
-    bool scan() { return (*this)[m_scan_index++]; }
-    void resync() { m_scan_index = m_scan_start; }
+    // Returns the next eight pixels to be scanned, packed MSB first,
+    // and advances the scan by eight.  This is for output engines
+    // that shift out a byte at a time.
+    uint8_t scanByte() {
+      const auto pixels = bitsAt(m_scan_field, m_scan_index) & m_output_mask;
+      m_scan_index += 8;
+      return pixels;
+    }
+
+    // Starts the scan of the next revolution.  An interlaced buffer
+    // alternates fields and returns true when it starts the odd one.
+    // The pixel clock must then fire its first interrupt after half a
+    // period, which shows the pixel before the first.  The rest of
+    // the odd field lands half a pixel after the even one.
+    bool resync() {
+      if (m_odd == nullptr || m_scan_field == m_odd) {
+        m_scan_field = m_buffer;
+        m_scan_index = m_scan_start;
+        return false;
+      }
+      m_scan_field = m_odd;
+      m_scan_index = m_scan_start - 1;
+      return true;
+    }
     void rotate(int amount = 1) {
       noInterrupts();
       m_scan_start += static_cast<uint8_t>(amount);
@@ -34,15 +209,124 @@ class PatternBuffer {
       m_scan_start = static_cast<uint8_t>(rot);
       interrupts();
     }
-    
+
+  protected:
+    // `odd` is storage for the odd field, or nullptr.
+    explicit PatternBuffer(uint8_t *odd) :
+      m_buffer(), m_odd(odd), m_scan_field(m_buffer),
+      m_scan_index(0), m_scan_start(0), m_output_mask(0xFF) {}
+
   private:
     uint8_t b(uint8_t i) const { return m_buffer[i >> 3]; }
-    uint8_t &b(uint8_t i)      { return m_buffer[i >> 3]; }
     static uint8_t mask(uint8_t i) { return 0b10000000 >> (i & 0b0111); }
-  
+
+    uint8_t fields() const { return m_odd != nullptr ? 2 : 1; }
+    // Without an odd field, field 1 is the same as field 0.
+    uint8_t *field(uint8_t f) {
+      return (f != 0 && m_odd != nullptr) ? m_odd : m_buffer;
+    }
+    const uint8_t *field(uint8_t f) const {
+      return (f != 0 && m_odd != nullptr) ? m_odd : m_buffer;
+    }
+
+    // Fine pixel `i` is pixel i/2 of field i%2.  The cast wraps the
+    // index around the cone.
+    uint8_t &fineByte(uint16_t i) {
+      return field(i & 1)[static_cast<uint8_t>(i >> 1) >> 3];
+    }
+    uint8_t fineByte(uint16_t i) const {
+      return field(i & 1)[static_cast<uint8_t>(i >> 1) >> 3];
+    }
+    static uint8_t fineMask(uint16_t i) { return mask(static_cast<uint8_t>(i >> 1)); }
+
+    // Applies `op` to every byte of every field.
+    template <typename Op>
+    void forEachByte(Op op) {
+      for (uint8_t f = 0; f < fields(); ++f) {
+        auto dst = field(f);
+        for (uint8_t k = 0; k < sizeof(m_buffer); ++k) op(dst[k]);
+      }
+    }
+
+    // Applies `op` to byte `k` of each field, with mask `m`.
+    template <typename Op>
+    void modify(uint8_t k, uint8_t m, Op op) {
+      k &= 0b00011111;
+      op(m_buffer[k], m);
+      if (m_odd != nullptr) op(m_odd[k], m);
+    }
+
+    // Returns the eight pixels of `buffer` starting at `i`, packed MSB
+    // first.  Since `i` need not be byte aligned, we may have to stitch
+    // two bytes together.
+    static uint8_t bitsAt(const uint8_t *buffer, uint8_t i) {
+      const auto shift = i & 0b0111;
+      const auto hi = buffer[i >> 3];
+      if (shift == 0) return hi;
+      const auto lo = buffer[((i >> 3) + 1) & 0b00011111];
+      return static_cast<uint8_t>((hi << shift) | (lo >> (8 - shift)));
+    }
+
+    template <typename Op>
+    void forRange(uint8_t first, uint16_t count, Op op) {
+      if (count > size()) count = size();
+      while (count > 0) {
+        const uint8_t bit = first & 0b0111;
+        const uint8_t n = (count < 8u - bit) ? count : 8u - bit;
+        const uint8_t m = (0xFF >> bit) & ~(0xFF >> (bit + n));
+        modify(first >> 3, m, op);
+        first += n;
+        count -= n;
+      }
+    }
+
+    void rotateField(uint8_t *buffer, int amount) {
+      const auto n = static_cast<uint8_t>(amount);
+      const uint8_t bytes = n >> 3;
+      const uint8_t bits = n & 0b0111;
+      if (bytes != 0) {
+        reverse(buffer, 0, sizeof(m_buffer));
+        reverse(buffer, 0, bytes);
+        reverse(buffer, bytes, sizeof(m_buffer));
+      }
+      if (bits != 0) {
+        uint8_t carry = buffer[sizeof(m_buffer) - 1] << (8 - bits);
+        for (uint8_t k = 0; k < sizeof(m_buffer); ++k) {
+          auto &b = buffer[k];
+          const uint8_t next_carry = b << (8 - bits);
+          b = (b >> bits) | carry;
+          carry = next_carry;
+        }
+      }
+    }
+
+    static void reverse(uint8_t *buffer, uint8_t begin, uint8_t end) {
+      while (begin + 1 < end) {
+        const auto t = buffer[begin];
+        buffer[begin++] = buffer[--end];
+        buffer[end] = t;
+      }
+    }
+
     uint8_t m_buffer[32];
+    uint8_t *m_odd;
+    const uint8_t *m_scan_field;  // the field being scanned
     uint8_t m_scan_index;
     uint8_t m_scan_start;
+    uint8_t m_output_mask;
+};
+
+// A PatternBuffer with its own odd field, for displaying all of the
+// fine pixels.  The odd field costs another 32 bytes of RAM, so only
+// the buffer being scanned needs to be interlaced.  Animations that
+// draw into other buffers (transitions, Compositor layers) get the
+// whole-pixel fallback until they draw into the display buffer again.
+class InterlacedPatternBuffer : public PatternBuffer {
+  public:
+    InterlacedPatternBuffer() : PatternBuffer(m_odd_field), m_odd_field() {}
+
+  private:
+    uint8_t m_odd_field[32];
 };
 
 #endif
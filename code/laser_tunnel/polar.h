@@ -0,0 +1,135 @@
+// Polar primitives
+// Adrian McCarthy 2022
+
+// Draws geometric primitives into a PatternBuffer in angle space, so
+// an animation can be a few calls with parameters that change each
+// revolution instead of a loop poking individual pixels.
+//
+// Angles are in pixels:  256 to a revolution, so they wrap naturally
+// in a uint8_t.  Sine and cosine come from a quarter-wave table in
+// PROGMEM scaled to +/-127.
+//
+// Each primitive is combined into the buffer with the current blend
+// mode.  `sector` uses the bulk range operations and costs about the
+// same as a single range op.  The others evaluate every pixel, but
+// they build each byte in a register and store it once.
+//
+// Estimated cost per call at 16 MHz with 256 pixels, from counting
+// instructions (a `sine` is about 20 cycles, and each byte's blend
+// about 20 more):
+//
+//   sector          ~15 us   (a range op over at most 32 bytes)
+//   spokes         ~200 us   (~10 cycles per pixel)
+//   wave           ~500 us   (~28 cycles per pixel)
+//   interference   ~850 us   (~50 cycles per pixel)
+//
+// Set BENCHMARK in the sketch to measure them on real hardware (see
+// benchmark.h), and update this table with what it prints.
+
+#ifndef POLAR_H
+#define POLAR_H
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include "patternbuffer.h"
+
+// sin(2*pi*i/256) scaled to 127, for i in [0, 64].
+const int8_t quarter_sine[65] PROGMEM = {
+    0,   3,   6,   9,  12,  16,  19,  22,  25,  28,  31,  34,  37,
+   40,  43,  46,  49,  51,  54,  57,  60,  63,  65,  68,  71,  73,
+   76,  78,  81,  83,  85,  88,  90,  92,  94,  96,  98, 100, 102,
+  104, 106, 107, 109, 111, 112, 113, 115, 116, 117, 118, 120, 121,
+  122, 122, 123, 124, 125, 125, 126, 126, 126, 127, 127, 127, 127
+};
+
+class PolarRenderer {
+  public:
+    explicit PolarRenderer(PatternBuffer &pattern) :
+      m_pattern(pattern), m_blend(PatternBuffer::BLEND_OR) {}
+
+    void setBlend(PatternBuffer::Blend blend) { m_blend = blend; }
+
+    static int8_t sine(uint8_t angle) {
+      const uint8_t i = angle & 0x3F;
+      const int8_t s = static_cast<int8_t>(pgm_read_byte(
+        &quarter_sine[(angle & 0x40) ? 64 - i : i]));
+      return (angle & 0x80) ? -s : s;
+    }
+    static int8_t cosine(uint8_t angle) { return sine(angle + 64); }
+
+    // The arc of `width` pixels beginning at `start`.
+    void sector(uint8_t start, uint16_t width) {
+      if (width > 256) width = 256;
+      switch (m_blend) {
+        case PatternBuffer::BLEND_COPY:
+          m_pattern.clear();
+          m_pattern.setRange(start, width);
+          break;
+        case PatternBuffer::BLEND_OR:   m_pattern.setRange(start, width); break;
+        case PatternBuffer::BLEND_AND:
+          m_pattern.clearRange(start + width, 256 - width);
+          break;
+        case PatternBuffer::BLEND_XOR:  m_pattern.toggleRange(start, width); break;
+        case PatternBuffer::BLEND_MASK: m_pattern.clearRange(start, width); break;
+        default: break;
+      }
+    }
+
+    // `count` evenly spaced sectors of `width` pixels, the first one
+    // beginning at `phase`.  The count needn't divide 256.
+    void spokes(uint8_t count, uint8_t phase, uint8_t width) {
+      // Track the position within the current spoke's period in units
+      // of 1/(256*count) of a revolution, so the spacing stays exact.
+      const uint16_t lit = static_cast<uint16_t>(width) * count;
+      uint8_t pos = static_cast<uint8_t>(-phase * count);
+      draw([&]() {
+        const bool on = pos < lit;
+        pos += count;
+        return on;
+      });
+    }
+
+    // Bands where a sine wave with `frequency` cycles per revolution
+    // exceeds `threshold`.  A threshold of 0 gives equal lit and dark
+    // bands; raise it for thinner bands.
+    void wave(uint8_t frequency, uint8_t phase, int8_t threshold) {
+      uint8_t angle = phase;
+      draw([&]() {
+        const bool on = sine(angle) > threshold;
+        angle += frequency;
+        return on;
+      });
+    }
+
+    // Lit where the sum of two sine waves exceeds `threshold`, which
+    // gives beat patterns when the frequencies are close.
+    void interference(uint8_t f1, uint8_t phase1, uint8_t f2, uint8_t phase2,
+                      int16_t threshold) {
+      uint8_t a1 = phase1;
+      uint8_t a2 = phase2;
+      draw([&]() {
+        const bool on = sine(a1) + sine(a2) > threshold;
+        a1 += f1;
+        a2 += f2;
+        return on;
+      });
+    }
+
+  private:
+    // Calls `lit` for each pixel in order, starting at pixel 0.
+    template <typename Predicate>
+    void draw(Predicate lit) {
+      for (uint8_t k = 0; k < m_pattern.size() / 8; ++k) {
+        uint8_t pixels = 0;
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+          pixels = (pixels << 1) | (lit() ? 1 : 0);
+        }
+        m_pattern.blendByte(k, pixels, m_blend);
+      }
+    }
+
+    PatternBuffer &m_pattern;
+    PatternBuffer::Blend m_blend;
+};
+
+#endif
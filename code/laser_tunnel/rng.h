@@ -0,0 +1,60 @@
+// Pseudorandom number generator
+// Adrian McCarthy 2022
+
+// Arduino's `random` uses 32-bit multiplies and divides, which are slow
+// on AVR, and it's never seeded, so every boot plays the same show.
+// This is a 16-bit xorshift generator (shifts 7, 9, 8), which takes
+// just a few shifts and exclusive-ors per number.  Its period is
+// 65535, which is plenty for animations.
+//
+// Ranges are computed with a multiply-high instead of a divide.
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <Arduino.h>
+
+class Rng {
+  public:
+    explicit Rng(uint16_t seed = 1) : m_state(seed ? seed : 1) {}
+
+    // A zero state would get stuck, so it's nudged to 1.
+    void seed(uint16_t s) { m_state = s ? s : 1; }
+
+    // Seeds from the noise in the least significant bits of an
+    // analog input, along with the time it took to collect them.
+    void seedFromNoise(int analog_pin) {
+      uint16_t s = 0;
+      for (uint8_t i = 0; i < 16; ++i) {
+        s = (s << 1) | (s >> 15);
+        s ^= static_cast<uint16_t>(analogRead(analog_pin));
+      }
+      seed(s ^ static_cast<uint16_t>(micros()));
+    }
+
+    uint16_t next() {
+      m_state ^= m_state << 7;
+      m_state ^= m_state >> 9;
+      m_state ^= m_state << 8;
+      return m_state;
+    }
+
+    // Returns a value in [0, n).
+    uint16_t below(uint16_t n) {
+      return static_cast<uint16_t>((static_cast<uint32_t>(next()) * n) >> 16);
+    }
+
+    // Returns a value in [lo, hi), or lo if the range is empty.
+    int16_t between(int16_t lo, int16_t hi) {
+      if (hi <= lo) return lo;
+      return lo + static_cast<int16_t>(below(static_cast<uint16_t>(hi - lo)));
+    }
+
+  private:
+    uint16_t m_state;
+};
+
+// Shared by all the animations.
+extern Rng rng;
+
+#endif
@@ -0,0 +1,105 @@
+// Cooperative scheduler
+// Adrian McCarthy 2022
+
+// Runs each subsystem as a task with a declared period and time budget,
+// measures how long each run actually takes, and keeps count of the
+// runs that exceed the budget.  Nothing is preempted--a task that
+// runs long still delays everything else--but the statistics show how
+// much headroom we have per revolution and which task is the hog.
+//
+// Times are measured with `micros`, which has a resolution of 4 us.
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+class Task {
+  public:
+    // `name` must point to a string in PROGMEM.  A period of 0 means
+    // the task runs on every pass.
+    Task(const char *name, void (*pfn)(),
+         uint16_t period_ms, uint16_t budget_us) :
+      m_name(name), m_pfn(pfn), m_period(period_ms), m_budget(budget_us),
+      m_last_run(0), m_worst(0), m_overruns(0), m_runs(0) {}
+
+    // Runs the task if it's due.  Returns the elapsed time in
+    // microseconds (0 if the task didn't run).
+    uint16_t poll(unsigned long now_ms) {
+      if (m_period != 0 && now_ms - m_last_run < m_period) return 0;
+      m_last_run = now_ms;
+      const auto start = micros();
+      (*m_pfn)();
+      const auto elapsed = micros() - start;
+      const uint16_t us = elapsed < 0xFFFFul ? elapsed : 0xFFFFu;
+      ++m_runs;
+      if (us > m_worst) m_worst = us;
+      if (us > m_budget && m_overruns < 0xFFFFu) ++m_overruns;
+      return us;
+    }
+
+    void resetStatistics() { m_worst = 0; m_overruns = 0; m_runs = 0; }
+
+    uint16_t worstCase() const { return m_worst; }
+    uint16_t overruns() const { return m_overruns; }
+    unsigned long runs() const { return m_runs; }
+
+    void printStatistics() const {
+      // Short enough for a console step (see console.h).
+      Serial.print(reinterpret_cast<const __FlashStringHelper *>(m_name));
+      Serial.print(F(": worst="));
+      Serial.print(m_worst);
+      Serial.print('/');
+      Serial.print(m_budget);
+      Serial.print(F(" us, overruns="));
+      Serial.print(m_overruns);
+      Serial.print(F("/"));
+      Serial.println(m_runs);
+    }
+
+  private:
+    const char *m_name;
+    void (*m_pfn)();
+    uint16_t m_period;
+    uint16_t m_budget;
+    unsigned long m_last_run;
+    uint16_t m_worst;
+    uint16_t m_overruns;
+    unsigned long m_runs;
+};
+
+template <uint8_t N>
+class Scheduler {
+  public:
+    explicit Scheduler(Task *(&tasks)[N]) : m_tasks(tasks), m_worst_pass(0) {}
+
+    // Call once per `loop`.  Runs each task that's due, in order.
+    void run() {
+      const auto now = millis();
+      uint16_t pass = 0;
+      for (uint8_t i = 0; i < N; ++i) pass += m_tasks[i]->poll(now);
+      if (pass > m_worst_pass) m_worst_pass = pass;
+    }
+
+    // The longest time a single pass through all the tasks has taken,
+    // in microseconds.
+    uint16_t worstPass() const { return m_worst_pass; }
+
+    void resetStatistics() {
+      for (uint8_t i = 0; i < N; ++i) m_tasks[i]->resetStatistics();
+      m_worst_pass = 0;
+    }
+
+    void printStatistics() const {
+      for (uint8_t i = 0; i < N; ++i) m_tasks[i]->printStatistics();
+      Serial.print(F("Worst pass: "));
+      Serial.print(m_worst_pass);
+      Serial.println(F(" us"));
+    }
+
+  private:
+    Task *(&m_tasks)[N];
+    uint16_t m_worst_pass;
+};
+
+#endif
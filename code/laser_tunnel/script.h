@@ -0,0 +1,278 @@
+// Animation scripts
+// Adrian McCarthy 2022
+
+// A tiny stack-based bytecode interpreter for animations.  Scripts can
+// live in flash (PROGMEM), EEPROM, or RAM, so new animations can be
+// loaded over the serial port without reflashing (see
+// scriptloader.h).
+//
+// Each revolution, the ScriptVM runs the script until it executes a
+// YIELD (or WAIT) or until it has used up its instruction budget.  If
+// the budget runs out, the script simply resumes where it left off at
+// the next revolution, so a script can never overrun the frame.
+//
+// The stack and the eight registers hold 16-bit values.  Stack
+// effects are shown as (before -- after).  Jump offsets are signed
+// bytes relative to the address following the offset.  Stack overflow
+// or underflow, or running off the end of the script, halts it.
+
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include "patternbuffer.h"
+#include "rng.h"
+
+enum ScriptOp : uint8_t {
+  OP_HALT,        // ( -- )  stop running the script
+  OP_YIELD,       // ( -- )  end this frame
+  OP_WAIT,        // (n -- )  end this frame and skip n-1 more
+  OP_PUSH8,       // ( -- x)  x is the next byte, sign extended
+  OP_PUSH16,      // ( -- x)  x is the next two bytes, low byte first
+  OP_FRAME,       // ( -- frame)
+  OP_LOAD,        // ( -- r[i])  i is the next byte
+  OP_STORE,       // (x -- )  r[i] = x, i is the next byte
+  OP_LOADX,       // (i -- r[i])
+  OP_DUP,         // (a -- a a)
+  OP_DROP,        // (a -- )
+  OP_SWAP,        // (a b -- b a)
+  OP_OVER,        // (a b -- a b a)
+  OP_ADD,         // (a b -- a+b)
+  OP_SUB,         // (a b -- a-b)
+  OP_MUL,         // (a b -- a*b)
+  OP_MOD,         // (a b -- a%b)  unsigned
+  OP_SHL,         // (a n -- a<<n)
+  OP_SHR,         // (a n -- a>>n)  unsigned
+  OP_EQ,          // (a b -- a==b)
+  OP_LT,          // (a b -- a<b)  signed
+  OP_RANDOM,      // (lo hi -- x)  lo <= x < hi
+  OP_JMP,         // ( -- )  offset is the next byte
+  OP_JZ,          // (x -- )  jump if x is zero
+  OP_LOOP,        // (n -- n-1)  jump if n-1 is not zero, else drop it
+  OP_SET,         // (i -- )  set pixel i
+  OP_CLEAR,       // (i -- )
+  OP_TOGGLE,      // (i -- )
+  OP_SETRANGE,    // (first count -- )
+  OP_CLEARRANGE,  // (first count -- )
+  OP_TOGGLERANGE, // (first count -- )
+  OP_CLEARALL,    // ( -- )
+  OP_TESTPATTERN, // ( -- )
+  OP_INVERT,      // ( -- )
+  OP_ROTATE,      // (n -- )  rotate the scan start
+  OP_SETROTATION, // (n -- )
+  OP_ROTATEPIXELS // (n -- )  rotate the buffer contents
+};
+
+class ScriptVM {
+  public:
+    enum Storage : uint8_t { IN_FLASH, IN_EEPROM, IN_RAM };
+
+    ScriptVM(const uint8_t *code, uint16_t length, Storage storage,
+             uint8_t budget = 128) :
+      m_code(code), m_length(length), m_storage(storage), m_budget(budget),
+      m_pc(0), m_sp(0), m_wait(0), m_steps(0), m_stack(), m_regs() {}
+
+    void load(const uint8_t *code, uint16_t length, Storage storage) {
+      m_code = code;
+      m_length = length;
+      m_storage = storage;
+      reset();
+    }
+
+    void reset() {
+      m_pc = 0;
+      m_sp = 0;
+      m_wait = 0;
+      for (auto &r : m_regs) r = 0;
+    }
+
+    void render(PatternBuffer &pattern, unsigned frame) {
+      if (frame == 0) reset();
+      m_steps = 0;
+      if (m_wait > 0) { --m_wait; return; }
+      while (m_steps < m_budget) {
+        ++m_steps;
+        if (!step(pattern, frame)) break;
+      }
+    }
+
+    // The number of instructions executed during the last revolution,
+    // for comparing the cost of scripts.
+    uint8_t steps() const { return m_steps; }
+
+  private:
+    uint8_t fetch() {
+      if (m_pc >= m_length) return OP_HALT;
+      const auto p = m_code + m_pc++;
+      switch (m_storage) {
+        case IN_FLASH:  return pgm_read_byte(p);
+        case IN_EEPROM: return eeprom_read_byte(p);
+        default:        return *p;
+      }
+    }
+
+    bool push(int16_t x) {
+      if (m_sp == STACK_SIZE) return halt();
+      m_stack[GUARD + m_sp++] = x;
+      return true;
+    }
+
+    bool halt() {
+      m_pc = m_length;
+      return false;
+    }
+
+    void jump(int8_t offset) { m_pc += offset; }
+
+    // Executes one instruction.  Returns false when the frame is done.
+    bool step(PatternBuffer &pattern, unsigned frame) {
+      const uint8_t op = fetch();
+
+      // Check the stack depth up front so the cases don't have to.
+      static const uint8_t PROGMEM pops[] = {
+        0, 0, 1, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 0, 1, 1, 1, 1, 1, 2, 2, 2, 0, 0, 0, 1, 1, 1
+      };
+      if (op >= sizeof(pops)) return halt();
+      if (m_sp < pgm_read_byte(&pops[op])) return halt();
+      int16_t &a = m_stack[GUARD + m_sp - 1];  // top of stack
+      int16_t &b = m_stack[GUARD + m_sp - 2];  // second from top
+
+      switch (op) {
+        case OP_HALT:         return halt();
+        case OP_YIELD:        return false;
+        case OP_WAIT:         m_wait = (a > 1) ? a - 1 : 0; --m_sp; return false;
+        case OP_PUSH8:        return push(static_cast<int8_t>(fetch()));
+        case OP_PUSH16: {
+          const uint8_t lo = fetch();
+          return push(static_cast<int16_t>((fetch() << 8) | lo));
+        }
+        case OP_FRAME:        return push(static_cast<int16_t>(frame));
+        case OP_LOAD:         return push(m_regs[fetch() & REG_MASK]);
+        case OP_STORE:        m_regs[fetch() & REG_MASK] = a; --m_sp; return true;
+        case OP_LOADX:        a = m_regs[a & REG_MASK]; return true;
+        case OP_DUP:          return push(a);
+        case OP_DROP:         --m_sp; return true;
+        case OP_SWAP:         { const auto t = a; a = b; b = t; } return true;
+        case OP_OVER:         return push(b);
+        case OP_ADD:          b += a; --m_sp; return true;
+        case OP_SUB:          b -= a; --m_sp; return true;
+        case OP_MUL:          b *= a; --m_sp; return true;
+        case OP_MOD:
+          if (a == 0) return halt();
+          b = static_cast<uint16_t>(b) % static_cast<uint16_t>(a); --m_sp; return true;
+        case OP_SHL:          b <<= (a & 0x0F); --m_sp; return true;
+        case OP_SHR:          b = static_cast<uint16_t>(b) >> (a & 0x0F); --m_sp; return true;
+        case OP_EQ:           b = (b == a); --m_sp; return true;
+        case OP_LT:           b = (b < a); --m_sp; return true;
+        case OP_RANDOM:       b = rng.between(b, a); --m_sp; return true;
+        case OP_JMP:          jump(static_cast<int8_t>(fetch())); return true;
+        case OP_JZ: {
+          const auto offset = static_cast<int8_t>(fetch());
+          if (a == 0) jump(offset);
+          --m_sp;
+          return true;
+        }
+        case OP_LOOP: {
+          const auto offset = static_cast<int8_t>(fetch());
+          if (--a != 0) jump(offset); else --m_sp;
+          return true;
+        }
+        case OP_SET:          pattern.setPixel(a);    --m_sp; return true;
+        case OP_CLEAR:        pattern.clearPixel(a);  --m_sp; return true;
+        case OP_TOGGLE:       pattern.togglePixel(a); --m_sp; return true;
+        case OP_SETRANGE:     pattern.setRange(b, a);    m_sp -= 2; return true;
+        case OP_CLEARRANGE:   pattern.clearRange(b, a);  m_sp -= 2; return true;
+        case OP_TOGGLERANGE:  pattern.toggleRange(b, a); m_sp -= 2; return true;
+        case OP_CLEARALL:     pattern.clear(); return true;
+        case OP_TESTPATTERN:  pattern.setTestPattern(); return true;
+        case OP_INVERT:       pattern.invert(); return true;
+        case OP_ROTATE:       pattern.rotate(a); --m_sp; return true;
+        case OP_SETROTATION:  pattern.setRotation(a); --m_sp; return true;
+        case OP_ROTATEPIXELS: pattern.rotateContent(a); --m_sp; return true;
+        default:              return halt();
+      }
+    }
+
+    // Two unused slots below the bottom of the stack let us take
+    // references to the top two entries before the depth is known.
+    static constexpr uint8_t GUARD = 2;
+    static constexpr uint8_t STACK_SIZE = 8;
+    static constexpr uint8_t REG_MASK = 0b0111;
+
+    const uint8_t *m_code;
+    uint16_t m_length;
+    Storage m_storage;
+    uint8_t m_budget;
+    uint16_t m_pc;
+    uint8_t m_sp;
+    uint16_t m_wait;
+    uint8_t m_steps;
+    int16_t m_stack[GUARD + STACK_SIZE];
+    int16_t m_regs[REG_MASK + 1];
+};
+
+// Scripted versions of the native animations, for comparison.
+
+// Glitch:  Show the test pattern and occasionally jerk it askew.
+const uint8_t glitch_script[] PROGMEM = {
+  OP_TESTPATTERN,
+  /* 1 */ OP_PUSH8, 0, OP_SETROTATION,
+  OP_PUSH8, 10, OP_PUSH8, 90, OP_RANDOM, OP_WAIT,
+  OP_PUSH8, static_cast<uint8_t>(-10), OP_PUSH8, 10, OP_RANDOM,
+  OP_PUSH8, 10, OP_MUL, OP_SETROTATION,
+  OP_PUSH8, 3, OP_PUSH8, 25, OP_RANDOM, OP_WAIT,
+  OP_JMP, static_cast<uint8_t>(1 - 27)
+};
+
+// RadialSeeds:  Four random seeds sprout in both directions.
+// Seed n lives in register n, for n = 1 through 4.
+const uint8_t radial_seeds_script[] PROGMEM = {
+  OP_CLEARALL,
+  OP_PUSH8, 0, OP_PUSH16, 0x00, 0x01, OP_RANDOM, OP_STORE, 1,
+  OP_PUSH8, 0, OP_PUSH16, 0x00, 0x01, OP_RANDOM, OP_STORE, 2,
+  OP_PUSH8, 0, OP_PUSH16, 0x00, 0x01, OP_RANDOM, OP_STORE, 3,
+  OP_PUSH8, 0, OP_PUSH16, 0x00, 0x01, OP_RANDOM, OP_STORE, 4,
+  /* 33 */ OP_PUSH8, 4,
+  /* 35 */ OP_DUP, OP_FRAME, OP_MUL, OP_PUSH8, 3, OP_SHR,  // n offset
+           OP_OVER, OP_LOADX,                             // n offset seed
+           OP_OVER, OP_OVER, OP_ADD, OP_SET,
+           OP_SWAP, OP_SUB, OP_SET,                       // n
+           OP_LOOP, static_cast<uint8_t>(35 - 52),
+  /* 52 */ OP_YIELD,
+           OP_JMP, static_cast<uint8_t>(33 - 55)
+};
+
+// RotaryCorruption:  Spin while randomly flipping pixels.
+const uint8_t rotary_corruption_script[] PROGMEM = {
+  OP_PUSH8, static_cast<uint8_t>(-1), OP_ROTATE,
+  OP_PUSH8, 0, OP_PUSH16, 0x00, 0x01, OP_RANDOM, OP_TOGGLE,
+  OP_YIELD,
+  OP_JMP, static_cast<uint8_t>(0 - 13)
+};
+
+// Composite:  WaxOn, then RotaryCorruption, then WaxOff.
+const uint8_t composite_script[] PROGMEM = {
+  /* 0 */  OP_CLEARALL, OP_PUSH8, 0, OP_SETROTATION, OP_YIELD,
+  /* 5 */  OP_PUSH16, 128, 0,
+  /* 8 */  OP_FRAME, OP_PUSH16, 0x74, 0x02, OP_MOD,  // frame % 628
+           OP_PUSH8, 1, OP_SHL, OP_PUSH8, 2, OP_SETRANGE,
+           OP_YIELD,
+           OP_LOOP, static_cast<uint8_t>(8 - 22),
+  /* 22 */ OP_PUSH16, 0x74, 0x01,                   // 372
+  /* 25 */ OP_PUSH8, static_cast<uint8_t>(-1), OP_ROTATE,
+           OP_PUSH8, 0, OP_PUSH16, 0x00, 0x01, OP_RANDOM, OP_TOGGLE,
+           OP_YIELD,
+           OP_LOOP, static_cast<uint8_t>(25 - 38),
+  /* 38 */ OP_PUSH8, 127,
+  /* 40 */ OP_PUSH16, 254, 0,
+           OP_FRAME, OP_PUSH16, 0x74, 0x02, OP_MOD,
+           OP_PUSH8, 1, OP_SHL, OP_SUB, OP_PUSH8, 2, OP_CLEARRANGE,
+           OP_YIELD,
+           OP_LOOP, static_cast<uint8_t>(40 - 58),
+  /* 58 */ OP_JMP, static_cast<uint8_t>(0 - 60)
+};
+
+#endif
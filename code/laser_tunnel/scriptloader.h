@@ -0,0 +1,147 @@
+// Script loader
+// Adrian McCarthy 2022
+
+// Receives an animation script over a serial stream and stores it in
+// EEPROM, where the `Scripted` animation will find it.  The loader is
+// non-blocking:  pass it the bytes received with `receive`, and call
+// `update` each time through `loop`.
+//
+// The host sends:  '#', 'S', the length (1 to MAX_LENGTH), the script
+// bytes, and a checksum byte (the low byte of the sum of the script
+// bytes).  Any other bytes are ignored.  If the bytes of a script
+// stop for more than BYTE_TIMEOUT, the loader gives up on it, so a
+// truncated upload doesn't swallow the console's input forever.
+//
+// An EEPROM write takes about 3.3 ms, which is much longer than a byte
+// takes to arrive, so the script is buffered in RAM and written to
+// EEPROM one byte at a time as the EEPROM becomes ready.
+//
+// EEPROM layout:  length, checksum, script bytes.  An erased EEPROM
+// reads as 0xFF, which is not a valid length.
+
+#ifndef SCRIPTLOADER_H
+#define SCRIPTLOADER_H
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include "timeout.h"
+
+class ScriptLoader {
+  public:
+    static constexpr uint8_t MAX_LENGTH = 128;
+    static constexpr unsigned long BYTE_TIMEOUT = 100;  // ms
+
+    ScriptLoader() :
+      m_state(WAITING), m_length(0), m_count(0), m_sum(0), m_timeout() {}
+
+    // Returns true when a new script has been completely stored.  Call
+    // before passing along newly received bytes, with the number
+    // waiting to be read.  Those arrived in time, so the upload times
+    // out only when there are none.
+    bool update(int available) {
+      if (available == 0 && m_timeout.expired()) {
+        m_timeout.cancel();
+        if (m_state != MARKED) Serial.println(F("Script timed out"));
+        m_state = WAITING;
+        return false;
+      }
+      if (m_state != WRITING || !eeprom_is_ready()) return false;
+
+      // Write the script first and the header last, so a partially
+      // stored script is never mistaken for a valid one.
+      if (m_count < m_length) {
+        eeprom_update_byte(address(CODE + m_count), m_buffer[m_count]);
+        ++m_count;
+        return false;
+      }
+      if (m_count == m_length) {
+        eeprom_update_byte(address(CHECKSUM), m_sum);
+        ++m_count;
+        return false;
+      }
+      eeprom_update_byte(address(LENGTH), m_length);
+      m_state = WAITING;
+      Serial.print(F("Stored script of "));
+      Serial.print(m_length);
+      Serial.println(F(" bytes"));
+      return true;
+    }
+
+    // True while the loader is in the middle of receiving or storing
+    // a script, so the bytes should not go anywhere else.  (After just
+    // the '#', the next byte might be meant for someone else.)
+    bool busy() const { return m_state != WAITING && m_state != MARKED; }
+
+    void receive(uint8_t b) {
+      switch (m_state) {
+        case WAITING:
+          if (b == '#') m_state = MARKED;
+          break;
+        case MARKED:
+          m_state = (b == 'S') ? SIZING : WAITING;
+          break;
+        case SIZING:
+          if (b == 0 || MAX_LENGTH < b) {
+            Serial.println(F("Script too long"));
+            m_state = WAITING;
+            break;
+          }
+          m_length = b;
+          m_count = 0;
+          m_sum = 0;
+          m_state = RECEIVING;
+          break;
+        case RECEIVING:
+          m_buffer[m_count++] = b;
+          m_sum += b;
+          if (m_count == m_length) m_state = CHECKING;
+          break;
+        case CHECKING:
+          if (b != m_sum) {
+            Serial.println(F("Script checksum mismatch"));
+            m_state = WAITING;
+            break;
+          }
+          // Invalidate the old script before overwriting it.
+          eeprom_update_byte(address(LENGTH), 0xFF);
+          m_count = 0;
+          m_state = WRITING;
+          break;
+        case WRITING:
+          // Ignore everything until the EEPROM is updated.
+          break;
+      }
+      if (m_state == WAITING || m_state == WRITING) m_timeout.cancel();
+      else m_timeout.set(BYTE_TIMEOUT);
+    }
+
+    // Returns the length of the stored script, or 0 if there isn't
+    // a valid one.
+    static uint8_t storedLength() {
+      const uint8_t length = eeprom_read_byte(address(LENGTH));
+      if (length == 0 || MAX_LENGTH < length) return 0;
+      uint8_t sum = 0;
+      for (uint8_t i = 0; i < length; ++i) sum += eeprom_read_byte(address(CODE + i));
+      return sum == eeprom_read_byte(address(CHECKSUM)) ? length : 0;
+    }
+
+    // The stored script, suitable for `ScriptVM::IN_EEPROM`.
+    static const uint8_t *storedScript() { return address(CODE); }
+
+  private:
+    enum State : uint8_t { WAITING, MARKED, SIZING, RECEIVING, CHECKING, WRITING };
+    enum : uint8_t { LENGTH = 0, CHECKSUM = 1, CODE = 2 };
+
+    static uint8_t *address(uint8_t offset) {
+      return reinterpret_cast<uint8_t *>(offset);
+    }
+
+    State m_state;
+    uint8_t m_length;
+    uint8_t m_count;
+    uint8_t m_sum;
+    Timeout<MillisClock> m_timeout;
+    uint8_t m_buffer[MAX_LENGTH];
+};
+
+#endif
@@ -0,0 +1,88 @@
+// Animation self-test
+// Adrian McCarthy 2022
+
+// Runs each animation for a fixed number of frames from a fixed random
+// seed and compares a CRC of the resulting sequence of frames to a
+// known-good ("golden") value.  This catches unintended changes to
+// the animations and to the PatternBuffer operations they use.
+//
+// If you change an animation on purpose, the mismatch report gives
+// the new CRC to paste into the table.
+//
+// `make -C code/test` runs the self-test on the host against a stub of
+// the Arduino core.  The sketch also runs it at startup when SELF_TEST
+// is set.
+
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include "animator.h"
+#include "patternbuffer.h"
+#include "rng.h"
+
+struct GoldenAnimation {
+  Animation animation;
+  uint16_t crc;
+};
+
+const GoldenAnimation golden_animations[] PROGMEM = {
+  { Glitch,           0xB9A2 },
+  { RadialSeeds,      0xB97C },
+  { RotaryCorruption, 0xA761 },
+  { Composite,        0xF699 },
+  { Layered,          0x60F4 },
+  { Spokes,           0x3731 },
+  { Vortex,           0xF056 },
+  { Marquee,          0xD54D },
+  { Pulse,            0x4EA6 }
+};
+
+uint16_t crcUpdate(uint16_t crc, uint8_t data) {
+  // CRC-16-CCITT
+  crc ^= static_cast<uint16_t>(data) << 8;
+  for (uint8_t i = 0; i < 8; ++i) {
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+uint16_t frameSequenceCRC(Animation animation, unsigned frames) {
+  constexpr uint16_t SEED = 0x5EED;
+  rng.seed(SEED);
+  PatternBuffer pattern;
+  AnimationState state;
+  uint16_t crc = 0xFFFF;
+  for (unsigned frame = 0; frame < frames; ++frame) {
+    animation(pattern, frame, state);
+    for (uint8_t k = 0; k < pattern.size() / 8; ++k) {
+      crc = crcUpdate(crc, pattern.displayedByte(k));
+    }
+  }
+  return crc;
+}
+
+// Returns true if every animation matches its golden CRC.
+bool checkAnimations() {
+  constexpr unsigned FRAMES = 200;
+  constexpr auto count = sizeof(golden_animations) / sizeof(golden_animations[0]);
+  bool passed = true;
+  for (uint8_t i = 0; i < count; ++i) {
+    GoldenAnimation golden;
+    memcpy_P(&golden, &golden_animations[i], sizeof(golden));
+    const auto crc = frameSequenceCRC(golden.animation, FRAMES);
+    if (crc == golden.crc) continue;
+    passed = false;
+    Serial.print(F("Animation "));
+    Serial.print(i);
+    Serial.print(F(" CRC is 0x"));
+    Serial.print(crc, HEX);
+    Serial.print(F(", expected 0x"));
+    Serial.println(golden.crc, HEX);
+  }
+  Serial.println(passed ? F("Animation self-test passed") : F("Animation self-test FAILED"));
+  return passed;
+}
+
+#endif
@@ -0,0 +1,89 @@
+// Keyframe sequences
+// Adrian McCarthy 2022
+
+// A SequencePlayer plays a designed sequence of frames stored in
+// flash (PROGMEM).  There's not enough RAM for more than a few
+// frames, so each frame is stored as the difference (XOR) from the
+// previous one, and the differences are run-length encoded.  The
+// player decodes one frame per revolution directly into the
+// PatternBuffer, so the cost is at most a few operations per byte of
+// the buffer regardless of the length of the sequence.
+//
+// The encoded data is a stream of tokens.  The low six bits of each
+// token hold a count, n, which is one less than the number of bytes
+// (or frames) it applies to.
+//
+//   00nnnnnn              skip n+1 unchanged bytes
+//   01nnnnnn b0 b1 ...    XOR the next n+1 bytes with b0, b1, ...
+//   10nnnnnn b            XOR the next n+1 bytes with b
+//   11nnnnnn              hold the current frame for n+1 frames
+//   11111111              end of sequence; start over
+//
+// A frame ends once tokens have accounted for all of the bytes in
+// the buffer.  A hold token stands in for an entire frame.  The first
+// frame is encoded relative to an empty buffer.
+//
+// Use code/tools/sequence.py to create the data.
+
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include "patternbuffer.h"
+
+class SequencePlayer {
+  public:
+    explicit SequencePlayer(const uint8_t *data) :
+      m_data(data), m_next(data), m_hold(0) {}
+
+    void render(PatternBuffer &pattern, unsigned frame) {
+      if (frame == 0) restart(pattern);
+      if (m_hold > 0) { --m_hold; return; }
+
+      uint8_t k = 0;
+      while (k < pattern.size() / 8) {
+        const uint8_t token = pgm_read_byte(m_next++);
+        uint8_t n = (token & COUNT) + 1;
+        switch (token & ~COUNT) {
+          case SKIP:
+            k += n;
+            break;
+          case LITERAL:
+            while (n-- > 0) pattern.toggleByte(k++, pgm_read_byte(m_next++));
+            break;
+          case RUN: {
+            const uint8_t pixels = pgm_read_byte(m_next++);
+            while (n-- > 0) pattern.toggleByte(k++, pixels);
+            break;
+          }
+          default:
+            if (token == END) {
+              restart(pattern);
+              break;  // decode the first frame again
+            }
+            m_hold = n - 1;  // this frame counts as the first
+            return;
+        }
+      }
+    }
+
+  private:
+    enum : uint8_t {
+      SKIP = 0x00, LITERAL = 0x40, RUN = 0x80, HOLD = 0xC0,
+      COUNT = 0x3F, END = 0xFF
+    };
+
+    void restart(PatternBuffer &pattern) {
+      pattern.clear();
+      pattern.setRotation(0);
+      m_next = m_data;
+      m_hold = 0;
+    }
+
+    const uint8_t *m_data;
+    const uint8_t *m_next;
+    uint8_t m_hold;
+};
+
+#endif
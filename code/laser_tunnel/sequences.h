@@ -0,0 +1,89 @@
+// Generated by code/tools/sequence.py.  Do not edit.
+
+#ifndef SEQUENCES_H
+#define SEQUENCES_H
+
+#include <avr/pgmspace.h>
+
+// spokes.txt: 67 frames in 923 bytes (2144 uncompressed)
+const uint8_t spokes_sequence[] PROGMEM = {
+  0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02,
+  0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02,
+  0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02,
+  0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02,
+  0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02,
+  0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02,
+  0x40, 0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03, 0x02,
+  0x40, 0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03, 0x02,
+  0x00, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0,
+  0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0,
+  0x01, 0x00, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40,
+  0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40,
+  0x30, 0x01, 0x00, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02,
+  0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02,
+  0x40, 0x0C, 0x01, 0x00, 0x40, 0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03,
+  0x02, 0x40, 0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03,
+  0x02, 0x40, 0x03, 0x01, 0x01, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40,
+  0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40,
+  0xC0, 0x02, 0x40, 0xC0, 0x00, 0x01, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02,
+  0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02,
+  0x40, 0x30, 0x02, 0x40, 0x30, 0x00, 0x01, 0x40, 0x0C, 0x02, 0x40, 0x0C,
+  0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C,
+  0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x00, 0x01, 0x40, 0x03, 0x02, 0x40,
+  0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03, 0x02, 0x40,
+  0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03, 0x00, 0x02, 0x40, 0xC0, 0x02,
+  0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02,
+  0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0xC0, 0x02, 0x40, 0x30, 0x02,
+  0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02,
+  0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x30, 0x02, 0x40, 0x0C, 0x02,
+  0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02,
+  0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x0C, 0x02, 0x40, 0x03, 0x02,
+  0x40, 0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03, 0x02,
+  0x40, 0x03, 0x02, 0x40, 0x03, 0x02, 0x40, 0x03, 0xD3, 0x40, 0x80, 0x01,
+  0x41, 0x01, 0x80, 0x01, 0x41, 0x01, 0x80, 0x01, 0x41, 0x01, 0x80, 0x01,
+  0x41, 0x01, 0x80, 0x01, 0x41, 0x01, 0x80, 0x01, 0x41, 0x01, 0x80, 0x01,
+  0x41, 0x01, 0x80, 0x01, 0x40, 0x01, 0x40, 0x40, 0x01, 0x41, 0x02, 0x40,
+  0x01, 0x41, 0x02, 0x40, 0x01, 0x41, 0x02, 0x40, 0x01, 0x41, 0x02, 0x40,
+  0x01, 0x41, 0x02, 0x40, 0x01, 0x41, 0x02, 0x40, 0x01, 0x41, 0x02, 0x40,
+  0x01, 0x40, 0x02, 0x40, 0x20, 0x01, 0x41, 0x04, 0x20, 0x01, 0x41, 0x04,
+  0x20, 0x01, 0x41, 0x04, 0x20, 0x01, 0x41, 0x04, 0x20, 0x01, 0x41, 0x04,
+  0x20, 0x01, 0x41, 0x04, 0x20, 0x01, 0x41, 0x04, 0x20, 0x01, 0x40, 0x04,
+  0x40, 0x10, 0x01, 0x41, 0x08, 0x10, 0x01, 0x41, 0x08, 0x10, 0x01, 0x41,
+  0x08, 0x10, 0x01, 0x41, 0x08, 0x10, 0x01, 0x41, 0x08, 0x10, 0x01, 0x41,
+  0x08, 0x10, 0x01, 0x41, 0x08, 0x10, 0x01, 0x40, 0x08, 0x40, 0x08, 0x01,
+  0x41, 0x10, 0x08, 0x01, 0x41, 0x10, 0x08, 0x01, 0x41, 0x10, 0x08, 0x01,
+  0x41, 0x10, 0x08, 0x01, 0x41, 0x10, 0x08, 0x01, 0x41, 0x10, 0x08, 0x01,
+  0x41, 0x10, 0x08, 0x01, 0x40, 0x10, 0x40, 0x04, 0x01, 0x41, 0x20, 0x04,
+  0x01, 0x41, 0x20, 0x04, 0x01, 0x41, 0x20, 0x04, 0x01, 0x41, 0x20, 0x04,
+  0x01, 0x41, 0x20, 0x04, 0x01, 0x41, 0x20, 0x04, 0x01, 0x41, 0x20, 0x04,
+  0x01, 0x40, 0x20, 0x40, 0x02, 0x01, 0x41, 0x40, 0x02, 0x01, 0x41, 0x40,
+  0x02, 0x01, 0x41, 0x40, 0x02, 0x01, 0x41, 0x40, 0x02, 0x01, 0x41, 0x40,
+  0x02, 0x01, 0x41, 0x40, 0x02, 0x01, 0x41, 0x40, 0x02, 0x01, 0x40, 0x40,
+  0x40, 0x01, 0x01, 0x41, 0x80, 0x01, 0x01, 0x41, 0x80, 0x01, 0x01, 0x41,
+  0x80, 0x01, 0x01, 0x41, 0x80, 0x01, 0x01, 0x41, 0x80, 0x01, 0x01, 0x41,
+  0x80, 0x01, 0x01, 0x41, 0x80, 0x01, 0x01, 0x40, 0x80, 0x00, 0x41, 0x80,
+  0x01, 0x01, 0x41, 0x80, 0x01, 0x01, 0x41, 0x80, 0x01, 0x01, 0x41, 0x80,
+  0x01, 0x01, 0x41, 0x80, 0x01, 0x01, 0x41, 0x80, 0x01, 0x01, 0x41, 0x80,
+  0x01, 0x01, 0x41, 0x80, 0x01, 0x00, 0x00, 0x41, 0x40, 0x02, 0x01, 0x41,
+  0x40, 0x02, 0x01, 0x41, 0x40, 0x02, 0x01, 0x41, 0x40, 0x02, 0x01, 0x41,
+  0x40, 0x02, 0x01, 0x41, 0x40, 0x02, 0x01, 0x41, 0x40, 0x02, 0x01, 0x41,
+  0x40, 0x02, 0x00, 0x00, 0x41, 0x20, 0x04, 0x01, 0x41, 0x20, 0x04, 0x01,
+  0x41, 0x20, 0x04, 0x01, 0x41, 0x20, 0x04, 0x01, 0x41, 0x20, 0x04, 0x01,
+  0x41, 0x20, 0x04, 0x01, 0x41, 0x20, 0x04, 0x01, 0x41, 0x20, 0x04, 0x00,
+  0x00, 0x41, 0x10, 0x08, 0x01, 0x41, 0x10, 0x08, 0x01, 0x41, 0x10, 0x08,
+  0x01, 0x41, 0x10, 0x08, 0x01, 0x41, 0x10, 0x08, 0x01, 0x41, 0x10, 0x08,
+  0x01, 0x41, 0x10, 0x08, 0x01, 0x41, 0x10, 0x08, 0x00, 0x00, 0x41, 0x08,
+  0x10, 0x01, 0x41, 0x08, 0x10, 0x01, 0x41, 0x08, 0x10, 0x01, 0x41, 0x08,
+  0x10, 0x01, 0x41, 0x08, 0x10, 0x01, 0x41, 0x08, 0x10, 0x01, 0x41, 0x08,
+  0x10, 0x01, 0x41, 0x08, 0x10, 0x00, 0x00, 0x41, 0x04, 0x20, 0x01, 0x41,
+  0x04, 0x20, 0x01, 0x41, 0x04, 0x20, 0x01, 0x41, 0x04, 0x20, 0x01, 0x41,
+  0x04, 0x20, 0x01, 0x41, 0x04, 0x20, 0x01, 0x41, 0x04, 0x20, 0x01, 0x41,
+  0x04, 0x20, 0x00, 0x00, 0x41, 0x02, 0x40, 0x01, 0x41, 0x02, 0x40, 0x01,
+  0x41, 0x02, 0x40, 0x01, 0x41, 0x02, 0x40, 0x01, 0x41, 0x02, 0x40, 0x01,
+  0x41, 0x02, 0x40, 0x01, 0x41, 0x02, 0x40, 0x01, 0x41, 0x02, 0x40, 0x00,
+  0x00, 0x41, 0x01, 0x80, 0x01, 0x41, 0x01, 0x80, 0x01, 0x41, 0x01, 0x80,
+  0x01, 0x41, 0x01, 0x80, 0x01, 0x41, 0x01, 0x80, 0x01, 0x41, 0x01, 0x80,
+  0x01, 0x41, 0x01, 0x80, 0x01, 0x41, 0x01, 0x80, 0x00, 0xCE, 0xFF,
+};
+
+#endif
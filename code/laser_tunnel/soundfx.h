@@ -4,28 +4,56 @@
 #include <Arduino.h>
 #include <SoftwareSerial.h>
 #include "audiomodule.h"
+#include "dfplayeremulator.h"
 #include "pins.h"
 
+// SoundFX handles the module's events with static dispatch (see
+// StaticAudioEventHandler).  To log the traffic with the module,
+// switch to the virtual DebugAudioEventHandler.
 #if 1
-#define SOUNDFX_BASE_CLASS AudioEventHandler
+#define SOUNDFX_BASE_CLASS StaticAudioEventHandler<SoundFX>
+#define SOUNDFX_HANDLER SoundFX
+#define SOUNDFX_LOGS_TRAFFIC false
 #else
 #define SOUNDFX_BASE_CLASS DebugAudioEventHandler
+#define SOUNDFX_HANDLER BasicAudioEventHandler
+#define SOUNDFX_LOGS_TRAFFIC true
+#endif
+
+// To run without an audio module, as when profiling startup, switch
+// to the emulator.
+#if 1
+#define SOUNDFX_SERIAL SoftwareSerial
+#else
+#define SOUNDFX_SERIAL DFPlayerEmulator
 #endif
 
 class SoundFX : public SOUNDFX_BASE_CLASS {
   public:
+    // True if the module's traffic is logged to `Serial`.
+    static constexpr bool LOGS_TRAFFIC = SOUNDFX_LOGS_TRAFFIC;
+
     SoundFX(int rx_pin, int tx_pin, int busy_pin) :
       m_serial(rx_pin, tx_pin),
       m_busy(busy_pin),
       m_module(m_serial),
       m_file_playing(0),
+      m_initialized(false),
       m_file_count(0),
       m_durations() {}
 
-    void begin() {
+    // After a warm restart (see failsafe.h), the module was never
+    // reset and is still initialized, so there's no need to wait for
+    // it to start over.  We just have to ask for the file count again.
+    void begin(bool warm = false) {
       m_busy.begin();
       m_module.begin(this);
-      m_module.reset();
+      if (warm) {
+        m_initialized = true;
+        m_module.queryFileCount(Audio::DEV_SDCARD);
+      } else {
+        m_module.reset();
+      }
     }
     void update() { m_module.update(); }
 
@@ -54,6 +82,12 @@ class SoundFX : public SOUNDFX_BASE_CLASS {
       return m_durations[file_index];
     }
 
+    // True once the module has reported that it's initialized.
+    bool initialized() const { return m_initialized; }
+
+    // The number of files on the SD card, or 0 if not yet known.
+    uint16_t fileCount() const { return m_file_count; }
+
     Track currentTrack() const {
       return static_cast<Track>(m_file_playing);
     }
@@ -82,7 +116,7 @@ class SoundFX : public SOUNDFX_BASE_CLASS {
 
     void stop() { play(NONE); }
 
-    void onDeviceInserted(Device src) override {
+    void onDeviceInserted(Device src) {
       SOUNDFX_BASE_CLASS::onDeviceInserted(src);
       if (src == Audio::DEV_SDCARD) {
         clearCache();
@@ -91,14 +125,14 @@ class SoundFX : public SOUNDFX_BASE_CLASS {
       }
     }
     
-    void onDeviceFileCount(Device src, uint16_t count) override {
+    void onDeviceFileCount(Device src, uint16_t count) {
       SOUNDFX_BASE_CLASS::onDeviceFileCount(src, count);
       if (src == Audio::DEV_SDCARD) {
         m_file_count = count;
       }
     }
 
-    void onDeviceRemoved(Device src) override {
+    void onDeviceRemoved(Device src) {
       SOUNDFX_BASE_CLASS::onDeviceRemoved(src);
       if (src == Audio::DEV_SDCARD) {
         m_file_playing = 0;
@@ -106,8 +140,9 @@ class SoundFX : public SOUNDFX_BASE_CLASS {
       }
     }
 
-    void onInitComplete(uint16_t devices) override {
+    void onInitComplete(uint16_t devices) {
       SOUNDFX_BASE_CLASS::onInitComplete(devices);
+      m_initialized = true;
       // Note that onInitComplete comes after a reset and also
       // after a select source command.  (I think that's because
       // the reset implicitly selects a source.)  Do not respond
@@ -119,7 +154,7 @@ class SoundFX : public SOUNDFX_BASE_CLASS {
       }
     }
 
-    void onFinishedFile(Device device, uint16_t file_index) override {
+    void onFinishedFile(Device device, uint16_t file_index) {
       SOUNDFX_BASE_CLASS::onFinishedFile(device, file_index);
       if (device != Audio::DEV_SDCARD) return;
       if (file_index != m_file_playing) return;
@@ -139,10 +174,11 @@ class SoundFX : public SOUNDFX_BASE_CLASS {
       for (auto &d : m_durations) d = 0uL;
     }
 
-    SoftwareSerial m_serial;
+    SOUNDFX_SERIAL m_serial;
     DigitalInputPin m_busy;
-    AudioModule<SoftwareSerial> m_module;
+    AudioModule<SOUNDFX_SERIAL, SOUNDFX_HANDLER> m_module;
     uint16_t m_file_playing;
+    bool m_initialized;
 
     // Cached metadata about the audio tracks.
     uint16_t m_file_count;
@@ -150,5 +186,8 @@ class SoundFX : public SOUNDFX_BASE_CLASS {
 };
 
 #undef SOUNDFX_BASE_CLASS
+#undef SOUNDFX_HANDLER
+#undef SOUNDFX_LOGS_TRAFFIC
+#undef SOUNDFX_SERIAL
 
 #endif
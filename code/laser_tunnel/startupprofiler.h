@@ -0,0 +1,94 @@
+// Startup profiler
+// Adrian McCarthy 2022
+
+// Records when each phase of startup begins and ends, from entering
+// `setup` until the tunnel is idle and ready for its first trigger, so
+// we have a baseline for making it boot faster.  Some phases overlap:
+// the audio module resets and counts its files while the fan spins up
+// and the calibrator measures it.
+//
+// Times are in milliseconds since power-on (as `millis` reports it),
+// kept in 16 bits, which is plenty for a startup.  To profile without
+// the audio module, see dfplayeremulator.h.
+
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+
+enum StartupPhase : uint8_t {
+  BOOT_SETUP,        // all of `setup`
+  BOOT_SELF_TEST,    // animation self-test and benchmarks
+  BOOT_AUDIO_RESET,  // audio module reset until init complete
+  BOOT_AUDIO_FILES,  // counting the audio files
+  BOOT_CALIBRATION,  // fan spin-up and measurement
+  BOOT_READY,        // start of `setup` until idle
+  BOOT_PHASE_COUNT
+};
+
+const char boot_setup_name[] PROGMEM = "setup";
+const char boot_self_test_name[] PROGMEM = "self-test";
+const char boot_audio_reset_name[] PROGMEM = "audio reset";
+const char boot_audio_files_name[] PROGMEM = "audio files";
+const char boot_calibration_name[] PROGMEM = "calibration";
+const char boot_ready_name[] PROGMEM = "ready";
+const char *const boot_phase_names[BOOT_PHASE_COUNT] PROGMEM = {
+  boot_setup_name, boot_self_test_name, boot_audio_reset_name,
+  boot_audio_files_name, boot_calibration_name, boot_ready_name
+};
+
+class StartupProfiler {
+  public:
+    StartupProfiler() : m_begin(), m_end(), m_begun(0), m_ended(0) {}
+
+    void begin(StartupPhase phase) {
+      if (m_begun & flag(phase)) return;
+      m_begin[phase] = millis();
+      m_begun |= flag(phase);
+    }
+
+    void end(StartupPhase phase) {
+      if (!(m_begun & flag(phase)) || (m_ended & flag(phase))) return;
+      m_end[phase] = millis();
+      m_ended |= flag(phase);
+    }
+
+    bool done(StartupPhase phase) const { return (m_ended & flag(phase)) != 0; }
+
+    // Milliseconds the phase took, or 0 if it hasn't finished.
+    uint16_t duration(StartupPhase phase) const {
+      return done(phase) ? m_end[phase] - m_begin[phase] : 0;
+    }
+
+    // Prints one line about a phase.
+    void printPhase(StartupPhase phase) const {
+      Serial.print(reinterpret_cast<const __FlashStringHelper *>(
+        pgm_read_ptr(&boot_phase_names[phase])));
+      if (!(m_begun & flag(phase))) {
+        Serial.println(F(": not started"));
+        return;
+      }
+      Serial.print(F(": "));
+      Serial.print(m_begin[phase]);
+      if (!done(phase)) {
+        Serial.println(F(" ms, not done"));
+        return;
+      }
+      Serial.print(F(" to "));
+      Serial.print(m_end[phase]);
+      Serial.print(F(" ms ("));
+      Serial.print(duration(phase));
+      Serial.println(F(" ms)"));
+    }
+
+  private:
+    static uint8_t flag(StartupPhase phase) { return 1u << phase; }
+
+    uint16_t m_begin[BOOT_PHASE_COUNT];
+    uint16_t m_end[BOOT_PHASE_COUNT];
+    uint8_t m_begun;
+    uint8_t m_ended;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define SUPPRESSOR_H
 
 #include <Arduino.h>
+#include "audioinput.h"
 #include "laser.h"
 #include "pins.h"
 #include "timeout.h"
@@ -17,13 +18,16 @@ class Suppressor {
       m_low.begin(INPUT_PULLUP);
     }
 
-    void update(Laser &laser) {
+    template <typename LaserType>
+    void update(LaserType &laser) {
       if (m_high.read() == HIGH || m_low.read() == LOW) {
         if (!m_timer.active()) {
           laser.disable();
-          Serial.print(F("Suppressing at least "));
-          Serial.print(duration());
-          Serial.println(F(" ms"));
+          if (!laser.ownsUsart()) {
+            Serial.print(F("Suppressing at least "));
+            Serial.print(duration());
+            Serial.println(F(" ms"));
+          }
         }
         m_timer.set(duration());
       }
@@ -34,9 +38,11 @@ class Suppressor {
       }
     }
 
+    bool active() const { return m_timer.active(); }
+
   private:
     unsigned long duration() const {
-      return map(analogRead(m_time_pin), 1023, 0, 3, 30)*1000;
+      return map(audio_input.read(m_time_pin), 1023, 0, 3, 30)*1000;
     }
 
     DigitalInputPin m_high;
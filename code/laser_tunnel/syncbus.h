@@ -0,0 +1,201 @@
+// Sync bus
+// Adrian McCarthy 2022
+
+// Keeps several laser tunnels in the same room in step.  One unit is
+// the leader.  Its serial TX is wired to the RX of every follower
+// (and the grounds are tied together).  The leader broadcasts a short
+// beat message when an effect starts, every few revolutions while it
+// runs, and when it ends.  A beat carries everything a follower needs
+// to join in, even part way through an effect:
+//
+//   * whether an effect is running,
+//   * the animation index and the random seed for the effect, so the
+//     follower renders exactly the same frames,
+//   * the leader's frame number, and
+//   * the time since the effect started, as the time reference for
+//     the cues.
+//
+// Followers start the same effect with the same seed, backdate their
+// cue timing by the elapsed time (plus the time the message spent on
+// the wire), and then nudge their animator a frame at a time toward
+// the leader's frame count.  Since each unit's frames come from its own
+// fan, the frames stay aligned to within about a revolution plus the
+// beat interval's worth of drift.
+//
+// A message is a start byte that never appears in the ASCII chatter on
+// the serial port, a type, a fixed-size payload, and a checksum.  Bytes
+// outside of a message are handed back so that the serial console
+// still works on a follower.
+//
+// A beat can wait in the leader's transmit buffer behind console
+// output, so the leader adds that time to the elapsed time it sends.
+// If the buffer doesn't have room for a whole beat, writing it would
+// stall the loop until there is, so the leader skips that beat and
+// lets the next one carry the timing.  (The beat that ends an effect
+// always goes out.)
+//
+// Nothing here touches the hardware directly:  messages are written to
+// any `Port` with `write(uint8_t)` and `availableForWrite()` methods,
+// the receiver is fed a byte at a time, and `follow` acts on a beat
+// through whatever `Effect` the caller provides.  code/test/syncbus.cpp
+// runs a leader and several followers on a host, connected with pipes,
+// and checks that they stay in step.
+
+#ifndef SYNCBUS_H
+#define SYNCBUS_H
+
+#include <Arduino.h>
+
+class SyncBus {
+  public:
+    enum Role : uint8_t { STANDALONE, LEADER, FOLLOWER };
+
+    struct Beat {
+      bool animating;
+      uint8_t animation;
+      uint16_t seed;
+      uint16_t frame;
+      unsigned long elapsed;  // ms since the effect started
+    };
+
+    // What `receive` did with a byte.
+    enum Status : uint8_t {
+      PASS,     // not part of a message
+      TAKEN,    // part of a message that isn't finished yet
+      READY     // completed a valid message; see `beat`
+    };
+
+    // The leader sends a beat every BEAT_FRAMES revolutions.
+    static constexpr uint8_t BEAT_FRAMES = 8;
+
+    SyncBus(Role role, long baud) :
+      m_role(role),
+      m_baud(baud), m_transit(delay(MESSAGE_SIZE)),
+      m_beat(), m_index(0), m_sum(0) {}
+
+    Role role() const { return m_role; }
+
+    // How long (in ms) a message takes to cross the wire.
+    unsigned long transit() const { return m_transit; }
+
+    // How long (in ms) `bytes` take to go out, at 10 bits per byte.
+    unsigned long delay(uint8_t bytes) const {
+      return bytes * 10000uL / m_baud;
+    }
+
+    // Broadcasts a beat, unless this isn't the leader or the port's
+    // transmit buffer is too full.  Returns true if it sent the beat.
+    template <typename Port>
+    bool send(Port &port, Beat beat) const {
+      if (m_role != LEADER) return false;
+      const int room = port.availableForWrite();
+      if (beat.animating && room < MESSAGE_SIZE) return false;
+      // The beat goes out after whatever is already in the buffer.
+      if (room < SERIAL_TX_BUFFER_SIZE - 1) {
+        beat.elapsed += delay(SERIAL_TX_BUFFER_SIZE - 1 - room);
+      }
+      uint8_t payload[PAYLOAD_SIZE] = {
+        static_cast<uint8_t>(beat.animating ? 1 : 0),
+        beat.animation,
+        static_cast<uint8_t>(beat.seed),
+        static_cast<uint8_t>(beat.seed >> 8),
+        static_cast<uint8_t>(beat.frame),
+        static_cast<uint8_t>(beat.frame >> 8),
+        static_cast<uint8_t>(beat.elapsed),
+        static_cast<uint8_t>(beat.elapsed >> 8),
+        static_cast<uint8_t>(beat.elapsed >> 16),
+        static_cast<uint8_t>(beat.elapsed >> 24)
+      };
+      uint8_t sum = TYPE_BEAT;
+      port.write(START);
+      port.write(TYPE_BEAT);
+      for (const auto b : payload) {
+        port.write(b);
+        sum += b;
+      }
+      port.write(static_cast<uint8_t>(~sum));
+      return true;
+    }
+
+    Status receive(uint8_t b) {
+      if (m_role != FOLLOWER) return PASS;
+      if (m_index == 0) {
+        if (b != START) return PASS;
+        m_index = 1;
+        return TAKEN;
+      }
+      if (m_index == 1) {
+        if (b != TYPE_BEAT) {
+          // Not one of ours after all.
+          m_index = 0;
+          return PASS;
+        }
+        m_sum = b;
+        m_index = 2;
+        return TAKEN;
+      }
+      if (m_index < 2 + PAYLOAD_SIZE) {
+        m_payload[m_index - 2] = b;
+        m_sum += b;
+        ++m_index;
+        return TAKEN;
+      }
+      m_index = 0;
+      if (static_cast<uint8_t>(~m_sum) != b) return TAKEN;  // corrupted
+      m_beat.animating = m_payload[0] != 0;
+      m_beat.animation = m_payload[1];
+      m_beat.seed = m_payload[2] | (static_cast<uint16_t>(m_payload[3]) << 8);
+      m_beat.frame = m_payload[4] | (static_cast<uint16_t>(m_payload[5]) << 8);
+      m_beat.elapsed = 0;
+      for (uint8_t i = 4; i > 0; --i) {
+        m_beat.elapsed = (m_beat.elapsed << 8) | m_payload[5 + i];
+      }
+      return READY;
+    }
+
+    // The most recent beat received.
+    const Beat &beat() const { return m_beat; }
+
+    // Joins, adjusts, or ends a follower's effect to match the most
+    // recent beat.  `Effect` provides:
+    //
+    //   bool running(), uint8_t animation(), uint16_t seed(),
+    //   unsigned long start() (the millis() when the effect began),
+    //   unsigned frame(), void begin(animation, seed, elapsed),
+    //   void end(), void shift(long ms), and void nudge(int frames).
+    //
+    // `now` is the current time in milliseconds.
+    template <typename Effect>
+    void follow(Effect &effect, unsigned long now) const {
+      if (!m_beat.animating) {
+        if (effect.running()) effect.end();
+        return;
+      }
+      const auto elapsed = m_beat.elapsed + m_transit;
+      if (!effect.running() || m_beat.animation != effect.animation() ||
+          m_beat.seed != effect.seed()) {
+        effect.begin(m_beat.animation, m_beat.seed, elapsed);
+      } else {
+        // Move the cues to line up with the leader's.
+        const long error = elapsed - (now - effect.start());
+        effect.shift(error);
+      }
+      effect.nudge(static_cast<int>(m_beat.frame - effect.frame()));
+    }
+
+  private:
+    static constexpr uint8_t START = 0xA5;
+    static constexpr uint8_t TYPE_BEAT = 'B';
+    static constexpr uint8_t PAYLOAD_SIZE = 10;
+    static constexpr uint8_t MESSAGE_SIZE = PAYLOAD_SIZE + 3;
+
+    Role m_role;
+    long m_baud;
+    unsigned long m_transit;
+    Beat m_beat;
+    uint8_t m_payload[PAYLOAD_SIZE];
+    uint8_t m_index;
+    uint8_t m_sum;
+};
+
+#endif
@@ -0,0 +1,164 @@
+// Scrolling text
+// Adrian McCarthy 2022
+
+// Scrolls a message around the tunnel, one font column per
+// revolution.  Each column of a glyph is a byte, and it occupies a
+// byte's worth of pixels (eight adjacent pixels, with the glyph's
+// bottom row first).  The buffer holds 32 columns at once, so about
+// five characters are visible.
+//
+// Each frame, the oldest column is overwritten with the next column
+// of the message, and the rotation moves it to the end of the scan.
+// That's one font lookup and one byte store per revolution no matter
+// how long the message is.
+//
+// The font is the classic 5x7, column-major with the top row in bit 0,
+// covering ' ' through 'Z'.  Lowercase letters are shown as uppercase,
+// and other characters are shown as spaces.
+
+#ifndef TEXTSCROLLER_H
+#define TEXTSCROLLER_H
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include "patternbuffer.h"
+
+const uint8_t font_5x7[] PROGMEM = {
+  0x00, 0x00, 0x00, 0x00, 0x00,  // ' '
+  0x00, 0x00, 0x5F, 0x00, 0x00,  // '!'
+  0x00, 0x07, 0x00, 0x07, 0x00,  // '"'
+  0x14, 0x7F, 0x14, 0x7F, 0x14,  // '#'
+  0x24, 0x2A, 0x7F, 0x2A, 0x12,  // '$'
+  0x23, 0x13, 0x08, 0x64, 0x62,  // '%'
+  0x36, 0x49, 0x55, 0x22, 0x50,  // '&'
+  0x00, 0x05, 0x03, 0x00, 0x00,  // '\''
+  0x00, 0x1C, 0x22, 0x41, 0x00,  // '('
+  0x00, 0x41, 0x22, 0x1C, 0x00,  // ')'
+  0x08, 0x2A, 0x1C, 0x2A, 0x08,  // '*'
+  0x08, 0x08, 0x3E, 0x08, 0x08,  // '+'
+  0x00, 0x50, 0x30, 0x00, 0x00,  // ','
+  0x08, 0x08, 0x08, 0x08, 0x08,  // '-'
+  0x00, 0x60, 0x60, 0x00, 0x00,  // '.'
+  0x20, 0x10, 0x08, 0x04, 0x02,  // '/'
+  0x3E, 0x51, 0x49, 0x45, 0x3E,  // '0'
+  0x00, 0x42, 0x7F, 0x40, 0x00,  // '1'
+  0x42, 0x61, 0x51, 0x49, 0x46,  // '2'
+  0x21, 0x41, 0x45, 0x4B, 0x31,  // '3'
+  0x18, 0x14, 0x12, 0x7F, 0x10,  // '4'
+  0x27, 0x45, 0x45, 0x45, 0x39,  // '5'
+  0x3C, 0x4A, 0x49, 0x49, 0x30,  // '6'
+  0x01, 0x71, 0x09, 0x05, 0x03,  // '7'
+  0x36, 0x49, 0x49, 0x49, 0x36,  // '8'
+  0x06, 0x49, 0x49, 0x29, 0x1E,  // '9'
+  0x00, 0x36, 0x36, 0x00, 0x00,  // ':'
+  0x00, 0x56, 0x36, 0x00, 0x00,  // ';'
+  0x08, 0x14, 0x22, 0x41, 0x00,  // '<'
+  0x14, 0x14, 0x14, 0x14, 0x14,  // '='
+  0x00, 0x41, 0x22, 0x14, 0x08,  // '>'
+  0x02, 0x01, 0x51, 0x09, 0x06,  // '?'
+  0x32, 0x49, 0x79, 0x41, 0x3E,  // '@'
+  0x7E, 0x11, 0x11, 0x11, 0x7E,  // 'A'
+  0x7F, 0x49, 0x49, 0x49, 0x36,  // 'B'
+  0x3E, 0x41, 0x41, 0x41, 0x22,  // 'C'
+  0x7F, 0x41, 0x41, 0x22, 0x1C,  // 'D'
+  0x7F, 0x49, 0x49, 0x49, 0x41,  // 'E'
+  0x7F, 0x09, 0x09, 0x01, 0x01,  // 'F'
+  0x3E, 0x41, 0x41, 0x51, 0x32,  // 'G'
+  0x7F, 0x08, 0x08, 0x08, 0x7F,  // 'H'
+  0x00, 0x41, 0x7F, 0x41, 0x00,  // 'I'
+  0x20, 0x40, 0x41, 0x3F, 0x01,  // 'J'
+  0x7F, 0x08, 0x14, 0x22, 0x41,  // 'K'
+  0x7F, 0x40, 0x40, 0x40, 0x40,  // 'L'
+  0x7F, 0x02, 0x04, 0x02, 0x7F,  // 'M'
+  0x7F, 0x04, 0x08, 0x10, 0x7F,  // 'N'
+  0x3E, 0x41, 0x41, 0x41, 0x3E,  // 'O'
+  0x7F, 0x09, 0x09, 0x09, 0x06,  // 'P'
+  0x3E, 0x41, 0x51, 0x21, 0x5E,  // 'Q'
+  0x7F, 0x09, 0x19, 0x29, 0x46,  // 'R'
+  0x46, 0x49, 0x49, 0x49, 0x31,  // 'S'
+  0x01, 0x01, 0x7F, 0x01, 0x01,  // 'T'
+  0x3F, 0x40, 0x40, 0x40, 0x3F,  // 'U'
+  0x1F, 0x20, 0x40, 0x20, 0x1F,  // 'V'
+  0x7F, 0x20, 0x18, 0x20, 0x7F,  // 'W'
+  0x63, 0x14, 0x08, 0x14, 0x63,  // 'X'
+  0x03, 0x04, 0x78, 0x04, 0x03,  // 'Y'
+  0x61, 0x51, 0x49, 0x45, 0x43,  // 'Z'
+};
+
+class TextScroller {
+  public:
+    static constexpr uint8_t GLYPH_WIDTH = 5;
+    static constexpr char FIRST_CHAR = ' ';
+    static constexpr char LAST_CHAR = 'Z';
+
+    // The message can be in PROGMEM or in RAM (for numbers and other
+    // text made on the fly).  It isn't copied, so it must outlive the
+    // scroller.  After the message, the scroller waits until the last
+    // column has scrolled out of view and starts over.
+    enum Storage : uint8_t { IN_FLASH, IN_RAM };
+
+    explicit TextScroller(const char *message, Storage storage = IN_FLASH) :
+      m_message(message), m_storage(storage), m_next(message), m_column(0),
+      m_gap(0) {}
+
+    void setMessage(const char *message, Storage storage = IN_FLASH) {
+      m_message = message;
+      m_storage = storage;
+      restart();
+    }
+
+    void restart() {
+      m_next = m_message;
+      m_column = 0;
+      m_gap = 0;
+    }
+
+    void render(PatternBuffer &pattern, unsigned frame) {
+      if (frame == 0) {
+        pattern.clear();
+        restart();
+      }
+      // With the rotation at 8*frame, the scan begins at byte
+      // `frame`, so the byte before it is the last one displayed.
+      const uint8_t last = static_cast<uint8_t>(frame) + COLUMNS - 1;
+      pattern.setByte(last, nextColumn());
+      pattern.setRotation(8 * static_cast<uint8_t>(frame));
+    }
+
+  private:
+    static constexpr uint8_t COLUMNS = 32;  // bytes in a PatternBuffer
+
+    char read(const char *p) const {
+      return m_storage == IN_FLASH ? static_cast<char>(pgm_read_byte(p)) : *p;
+    }
+
+    uint8_t nextColumn() {
+      if (m_gap != 0) {
+        if (--m_gap == 0) restart();
+        return 0;
+      }
+      char ch = read(m_next);
+      if (ch == '\0') {
+        m_gap = COLUMNS - 1;
+        return 0;
+      }
+      // One blank column between glyphs.
+      if (m_column == GLYPH_WIDTH) {
+        m_column = 0;
+        ++m_next;
+        return 0;
+      }
+      if ('a' <= ch && ch <= 'z') ch -= 'a' - 'A';
+      if (ch < FIRST_CHAR || LAST_CHAR < ch) ch = ' ';
+      const auto index = (ch - FIRST_CHAR) * GLYPH_WIDTH + m_column++;
+      return pgm_read_byte(&font_5x7[index]);
+    }
+
+    const char *m_message;
+    Storage m_storage;
+    const char *m_next;
+    uint8_t m_column;
+    uint8_t m_gap;
+};
+
+#endif
@@ -8,11 +8,11 @@ template <int N>
 class Timer {
   public:
     void begin(float freq) { start(freq); }
-    void begin(uint8_t prescaler_index, uint8_t limit) {
+    void begin(uint8_t prescaler_index, uint16_t limit) {
       start(prescaler_index, limit);
     }
 
-    void start(uint8_t prescaler_index, uint8_t limit);
+    void start(uint8_t prescaler_index, uint16_t limit);
     void start(float freq) {
       Serial.print("  prescaler * limit = ");
       Serial.print(F_CPU);
@@ -28,7 +28,7 @@ class Timer {
         const auto prescaler = prescalers[i];
         if (prescaler == 0) continue;
         const long limit = static_cast<long>(pre_times_lim / prescaler + 0.5f);
-        if (limit < 1 || 255 < limit) continue;
+        if (limit < 1 || max_limit < limit) continue;
         const float actual = static_cast<float>(F_CPU) / prescaler / limit;
         const float delta = actual - freq;
         Serial.print(F("  prescaler="));
@@ -47,14 +47,58 @@ class Timer {
     }
 
     void stop();
-    void resync();
+    // Restarts the current period.  With `half_period`, the next
+    // interrupt comes after only half a period.
+    void resync(bool half_period = false);
+
+    // Stops and restarts the interrupts without changing the timing.
+    void pause();
+    void resume();
 
   private:
     static const long prescalers[8];
+    static const long max_limit;
 };
 
 template <>
-void Timer<2>::start(uint8_t prescaler_index, uint8_t limit) {
+void Timer<1>::start(uint8_t prescaler_index, uint16_t limit) {
+  // Set the wave generation mode (4 bits across two registers) to
+  // compare timer/counter (CTC) to OCR1A.
+  TCCR1A = 0;
+  TCCR1B = (1 << WGM12) | (prescaler_index & 0b00000111);
+  TCNT1 = 0;  // start counting from 0.
+  OCR1A = limit - 1;  // count up to the limit
+  TIMSK1 |= (1 << OCIE1A);  // enable interrupt each time the counter reaches the limit
+}
+
+template <>
+void Timer<1>::stop() {
+  TCCR1B = 0;  // change the clock source to none
+  TIMSK1 = 0;  // disable the interrupt
+}
+
+template <>
+void Timer<1>::resync(bool half_period) {
+  TCNT1 = half_period ? OCR1A / 2 : 0;
+}
+
+template <>
+void Timer<1>::pause() { TIMSK1 &= ~(1 << OCIE1A); }
+
+template <>
+void Timer<1>::resume() { TIFR1 = (1 << OCF1A); TIMSK1 |= (1 << OCIE1A); }
+
+// Indexes 6 and 7 select an external clock source, which we don't use.
+template <>
+const long Timer<1>::prescalers[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+
+// The limit has to fit the uint16_t that `start` takes (65536 would
+// become 0, and OCR1A would reach 0xFFFF only by wrapping around).
+template <>
+const long Timer<1>::max_limit = 65535;
+
+template <>
+void Timer<2>::start(uint8_t prescaler_index, uint16_t limit) {
   // Set the wave generation mode (3 bits across two registers) to
   // compare timer/counter (CTC) to OCR2A.
   TCCR2A = (TCCR2A & 0b11111100) | (1 << WGM21);
@@ -73,9 +117,20 @@ void Timer<2>::stop() {
 }
 
 template <>
-void Timer<2>::resync() { TCNT2 = 0; }
+void Timer<2>::resync(bool half_period) {
+  TCNT2 = half_period ? OCR2A / 2 : 0;
+}
+
+template <>
+void Timer<2>::pause() { TIMSK2 &= ~(1 << OCIE2A); }
+
+template <>
+void Timer<2>::resume() { TIFR2 = (1 << OCF2A); TIMSK2 |= (1 << OCIE2A); }
 
 template <>
 const long Timer<2>::prescalers[8] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
 
+template <>
+const long Timer<2>::max_limit = 255;
+
 #endif
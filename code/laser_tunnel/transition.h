@@ -0,0 +1,63 @@
+// Transitions
+// Adrian McCarthy 2022
+
+// Blends the outgoing and incoming animations while the Animator
+// switches from one to the other.  Each revolution of the transition,
+// both animations render into their own buffers, and `blend` builds
+// the output from them a byte at a time, so a transition costs little
+// more than running the two animations.
+//
+// `step` counts from 1 to `length`.  At the last step, the output is
+// entirely the incoming animation.
+
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+#include <Arduino.h>
+#include "patternbuffer.h"
+
+enum Transition : uint8_t {
+  TRANSITION_CUT,        // switch immediately
+  TRANSITION_WIPE,       // a boundary sweeps around the cone
+  TRANSITION_DISSOLVE,   // pixels switch over in random order
+  TRANSITION_ROTATE_OUT  // the outgoing pattern spins away
+};
+
+inline void blendTransition(
+  PatternBuffer &output, const PatternBuffer &from, const PatternBuffer &to,
+  Transition transition, uint8_t step, uint8_t length
+) {
+  // Pixels before `edge` come from the incoming animation.
+  uint16_t edge = (transition == TRANSITION_ROTATE_OUT)
+    ? static_cast<uint32_t>(step) * step * output.size() /
+        (static_cast<uint16_t>(length) * length)
+    : static_cast<uint16_t>(step) * output.size() / length;
+  const uint8_t shift = static_cast<uint8_t>(edge);
+
+  for (uint8_t k = 0; k < output.size() / 8; ++k) {
+    const uint16_t first = 8*k;
+    uint8_t mask = 0;
+    if (transition == TRANSITION_DISSOLVE) {
+      // Each pixel switches over when the edge passes its rank in a
+      // fixed shuffle.  Both steps of the hash are invertible, so
+      // every rank is used exactly once.
+      for (uint8_t i = 0; i < 8; ++i) {
+        uint8_t rank = static_cast<uint8_t>(first + i) * 0x95 + 0x3B;
+        rank ^= rank >> 3;
+        mask = (mask << 1) | (rank < edge ? 1 : 0);
+      }
+    } else if (first + 8 <= edge) {
+      mask = 0xFF;
+    } else if (first < edge) {
+      mask = ~(0xFF >> (edge - first));
+    }
+
+    // Rotating out pushes the outgoing pattern ahead of the edge.
+    const uint8_t outgoing = (transition == TRANSITION_ROTATE_OUT)
+      ? from.displayedBits(static_cast<uint8_t>(first - shift))
+      : from.displayedByte(k);
+    output.setByte(k, (to.displayedByte(k) & mask) | (outgoing & ~mask));
+  }
+}
+
+#endif
@@ -0,0 +1,135 @@
+// Hardware-serialized laser output
+// Adrian McCarthy 2022
+
+// An alternative to bit-banging the laser from the pixel clock ISR.
+// The ATmega328's USART0 is run in Master SPI Mode (MSPIM), and the
+// laser is driven from its data-out pin (TXD).  The hardware shifts
+// out eight pixels per byte, so the CPU services just one interrupt
+// per eight pixels.  The baud-rate generator takes the place of the
+// Timer2 pixel clock.
+//
+// This requires rewiring:  the laser must be driven from pin 1 (TXD)
+// instead of pin 4.  In MSPIM, pin 4 (XCK) outputs the shift clock,
+// so it must not be connected to the laser.
+//
+// The USART is also what `Serial` uses, so `start` shuts down the
+// serial monitor, and `stop` hands the USART back to it.  In between,
+// nothing may write to `Serial`:  HardwareSerial would load UDR0
+// itself, so the bytes would be shifted out as pixels, and the chain
+// of transmit-complete interrupts would break.  Code that prints while
+// the laser may be running checks `ownsUsart` first.  The console and
+// the other serial protocols are ignored while the laser has the
+// USART, and the sync bus can't be used at all.
+//
+// Note that while `Serial` has the USART, TXD idles high, which turns
+// on a laser wired to it, so `stop` should be paired with gating the
+// laser's power where the hardware allows.
+//
+// Caveats:
+//  * We use the transmit-complete interrupt rather than the data
+//    register empty interrupt because HardwareSerial already owns the
+//    latter.  That leaves a tiny gap (ISR latency) between bytes.
+//  * A revolution resync takes effect at the next byte boundary, so
+//    the start of the pattern can lag by up to eight pixels.
+//  * Disabling the transmitter takes effect only after the byte in
+//    progress, so `disable` can take up to eight pixel periods.
+
+#ifndef USARTLASER_H
+#define USARTLASER_H
+
+#include <Arduino.h>
+
+class UsartLaser {
+  public:
+    UsartLaser() : m_enabled(false) {}
+
+    void begin() {
+      // While the transmitter is disabled, TXD reverts to a regular
+      // output pin, which we hold low so that the laser is off.
+      PORTD &= ~(1 << PORTD1);
+      DDRD  |=  (1 << DDD1);
+      enable();
+    }
+
+    void enable() {
+      noInterrupts();
+      m_enabled = true;
+      if ((UCSR0C & (1 << UMSEL00)) && !(UCSR0B & (1 << TXEN0))) {
+        // With the transmitter disabled, the chain of interrupts
+        // stopped, so we have to prime it again.
+        UCSR0B |= (1 << TXEN0);
+        UDR0 = 0;
+      }
+      interrupts();
+    }
+
+    void disable() {
+      noInterrupts();
+      m_enabled = false;
+      UCSR0B &= ~(1 << TXEN0);
+      interrupts();
+    }
+
+    // Like `disable`, but leaves interrupts off, for an ISR that must
+    // not be interrupted.  `shift` sends only zeros from here on, so
+    // the byte in progress is the last one with any pixels lit.
+    void kill() {
+      m_enabled = false;
+      UCSR0B &= ~(1 << TXEN0);
+      PORTD &= ~(1 << PORTD1);
+    }
+
+    // Starts shifting out pixels at (approximately) `pixel_freq`.
+    void start(float pixel_freq) {
+      // In MSPIM, the bit rate is F_CPU / (2*(UBRR0 + 1)).
+      const long ubrr = static_cast<long>(F_CPU / (2.0f * pixel_freq) + 0.5f) - 1;
+      Serial.print(F("  UBRR0="));
+      Serial.print(ubrr);
+      Serial.print(F(", actual="));
+      Serial.print(static_cast<float>(F_CPU) / (2 * (ubrr + 1)));
+      Serial.println(F(" Hz"));
+      if (ubrr < 0 || 4095 < ubrr) {
+        Serial.println(F("No solution for that frequency."));
+        return;
+      }
+      Serial.println(F("Handing the USART to the laser.  Goodbye."));
+      Serial.flush();
+      Serial.end();
+
+      // Initialization sequence per the datasheet:  the baud rate
+      // register must be zero while the mode is set and the
+      // transmitter is enabled.
+      noInterrupts();
+      UBRR0 = 0;
+      DDRD |= (1 << PD4);  // XCK must be an output for master mode
+      UCSR0C = (1 << UMSEL01) | (1 << UMSEL00);  // MSPIM, MSB first, mode 0
+      UCSR0B = (m_enabled ? (1 << TXEN0) : 0) | (1 << TXCIE0);
+      UBRR0 = static_cast<uint16_t>(ubrr);
+      // Prime the pump.  Each transmit-complete interrupt queues the
+      // next byte.
+      UDR0 = 0;
+      interrupts();
+    }
+
+    // Stops shifting out pixels and gives the USART back to `Serial`.
+    void stop(long serial_baud) {
+      noInterrupts();
+      UCSR0B = 0;
+      UCSR0C = 0;
+      interrupts();
+      Serial.begin(serial_baud);
+    }
+
+    // True while the USART is shifting out pixels rather than serving
+    // `Serial`.
+    bool ownsUsart() const { return (UCSR0C & (1 << UMSEL00)) != 0; }
+
+    // Call from the USART transmit-complete ISR with the next eight
+    // pixels.
+    void shift(uint8_t pixels) { UDR0 = m_enabled ? pixels : 0; }
+
+  private:
+    bool m_enabled;
+};
+
+#endif
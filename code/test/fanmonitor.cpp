@@ -0,0 +1,135 @@
+// Fan monitor test
+// Adrian McCarthy 2022
+
+// Feeds FanMonitor (see fanmonitor.h) the revolution start times the
+// fan pulse ISR would produce and checks what it makes of them.
+
+#include <Arduino.h>
+#include <stdio.h>
+#include "fanmonitor.h"
+
+namespace {
+
+constexpr unsigned long PERIOD = 20000;  // us, 3000 RPM
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+  if (condition) return;
+  printf("FAILED: %s\n", what);
+  ++failures;
+}
+
+// A rev_start left over from calibration (or still 0) mustn't be
+// mistaken for the start of a very long revolution.
+void testStaleStart() {
+  FanMonitor monitor;
+  unsigned long now = 5000000;
+  unsigned long rev_start = 0;
+  monitor.begin(PERIOD, rev_start, now);
+  rev_start = now + 3000;
+  now = rev_start + 100;
+  check(!monitor.update(rev_start, now), "first start only seeds");
+  check(monitor.fault() == FanMonitor::NONE, "no fault after stale start");
+  for (int i = 0; i < 20; ++i) {
+    rev_start += PERIOD;
+    now = rev_start + 100;
+    check(monitor.update(rev_start, now), "revolution counted");
+  }
+  check(monitor.fault() == FanMonitor::NONE, "no fault at steady speed");
+  check(monitor.revolutions() == 20, "revolutions");
+  check(monitor.lastPeriod() == PERIOD, "last period");
+  check(monitor.meanPeriod() == PERIOD, "mean period");
+}
+
+// One missed pulse makes a revolution 1.5 periods long and leaves the
+// ISR a half revolution out of phase.
+void testSingleMiss() {
+  FanMonitor monitor;
+  unsigned long rev_start = 1000;
+  monitor.begin(PERIOD, rev_start, rev_start);
+  rev_start += PERIOD;
+  monitor.update(rev_start, rev_start);
+  rev_start += PERIOD;
+  check(monitor.update(rev_start, rev_start), "revolution before miss");
+  rev_start += PERIOD + PERIOD/2;
+  check(!monitor.update(rev_start, rev_start), "missed revolution not counted");
+  check(monitor.missedPulses() == 1, "single miss counted");
+  check(monitor.slipped(), "single miss slips the phase");
+  check(monitor.lastPeriod() == PERIOD, "miss not used for regulation");
+  // After the sketch flips the toggle, the next start is half a
+  // revolution later.
+  rev_start += PERIOD/2;
+  check(!monitor.update(rev_start, rev_start), "resync only seeds");
+  check(!monitor.slipped(), "slip reported once");
+  rev_start += PERIOD;
+  check(monitor.update(rev_start, rev_start), "revolution after resync");
+  check(monitor.fault() == FanMonitor::NONE, "no fault for one miss");
+}
+
+// Two missed pulses keep the phase but still count.
+void testDoubleMiss() {
+  FanMonitor monitor;
+  unsigned long rev_start = 1000;
+  monitor.begin(PERIOD, rev_start, rev_start);
+  rev_start += PERIOD;
+  monitor.update(rev_start, rev_start);
+  rev_start += 2*PERIOD;
+  check(!monitor.update(rev_start, rev_start), "double miss not counted");
+  check(monitor.missedPulses() == 2, "double miss counted");
+  check(!monitor.slipped(), "double miss keeps the phase");
+  rev_start += PERIOD;
+  check(monitor.update(rev_start, rev_start), "revolution after double miss");
+}
+
+void testConsecutiveMisses() {
+  FanMonitor monitor;
+  unsigned long rev_start = 1000;
+  monitor.begin(PERIOD, rev_start, rev_start);
+  rev_start += PERIOD;
+  monitor.update(rev_start, rev_start);
+  for (int i = 0; i < 3; ++i) {
+    rev_start += 2*PERIOD;
+    monitor.update(rev_start, rev_start);
+  }
+  check(monitor.fault() == FanMonitor::MISSED_PULSES, "consecutive misses");
+}
+
+void testStall() {
+  FanMonitor monitor;
+  unsigned long rev_start = 1000;
+  monitor.begin(PERIOD, 0, rev_start);
+  rev_start += PERIOD;
+  monitor.update(rev_start, rev_start);
+  monitor.update(rev_start, rev_start + 3*PERIOD);
+  check(monitor.fault() == FanMonitor::NONE, "no stall yet");
+  monitor.update(rev_start, rev_start + 3*PERIOD + 1);
+  check(monitor.fault() == FanMonitor::STALL, "stall");
+}
+
+void testDrift() {
+  FanMonitor monitor;
+  unsigned long rev_start = 1000;
+  monitor.begin(PERIOD, rev_start, rev_start);
+  rev_start += PERIOD;
+  monitor.update(rev_start, rev_start);
+  for (int i = 0; i < 100 && monitor.fault() == FanMonitor::NONE; ++i) {
+    rev_start += PERIOD + PERIOD/5;
+    monitor.update(rev_start, rev_start);
+  }
+  check(monitor.fault() == FanMonitor::DRIFT, "drift");
+  check(monitor.missedPulses() == 0, "slow revolutions aren't misses");
+}
+
+}
+
+int main() {
+  testStaleStart();
+  testSingleMiss();
+  testDoubleMiss();
+  testConsecutiveMisses();
+  testStall();
+  testDrift();
+  printf(failures ? "Fan monitor test FAILED\n" : "Fan monitor test passed\n");
+  return failures ? 1 : 0;
+}
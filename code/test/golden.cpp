@@ -0,0 +1,12 @@
+// Golden-frame test
+// Adrian McCarthy 2022
+
+// Runs the animation self-test (see selftest.h) on the host, so the
+// golden CRCs are checked on every change without flashing a board.
+
+#include <Arduino.h>
+#include "selftest.h"
+
+int main() {
+  return checkAnimations() ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+// Arduino stub for host tests
+// Adrian McCarthy 2022
+
+// Just enough of the Arduino core to compile the sketch's hardware-
+// independent headers on a PC.  Time stands still unless a test moves
+// it:  `micros` and `millis` read `host_micros`.  Serial output goes to
+// stdout, and Serial input comes from `host_serial_input`.
+
+#ifndef ARDUINO_STUB_H
+#define ARDUINO_STUB_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define DEC 10
+#define HEX 16
+#define F_CPU 16000000UL
+#define SERIAL_TX_BUFFER_SIZE 64
+
+#define _BV(b) (1 << (b))
+
+extern unsigned long host_micros;
+inline unsigned long micros() { return host_micros; }
+inline unsigned long millis() { return host_micros / 1000; }
+inline void delay(unsigned long ms) { host_micros += ms * 1000; }
+inline void delayMicroseconds(unsigned us) { host_micros += us; }
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+long random(long limit);
+long random(long low, long high);
+void randomSeed(unsigned long seed);
+int analogRead(uint8_t pin);
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+uint8_t digitalPinToBitMask(uint8_t pin);
+uint8_t digitalPinToPort(uint8_t pin);
+volatile uint8_t *portOutputRegister(uint8_t port);
+volatile uint8_t *portInputRegister(uint8_t port);
+volatile uint8_t *portModeRegister(uint8_t port);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(int interrupt, void (*isr)(), int mode);
+void detachInterrupt(int interrupt);
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t b) = 0;
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *s) { return write(reinterpret_cast<const uint8_t *>(s), strlen(s)); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t print(const __FlashStringHelper *s);
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(int n, int base = DEC) { return print(static_cast<long>(n), base); }
+    size_t print(unsigned n, int base = DEC) { return print(static_cast<unsigned long>(n), base); }
+    size_t print(unsigned char n, int base = DEC) { return print(static_cast<unsigned long>(n), base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double x, int digits = 2);
+
+    template <typename T>
+    size_t println(T x) { return print(x) + println(); }
+    template <typename T>
+    size_t println(T x, int format) { return print(x, format) + println(); }
+    size_t println() { return write(reinterpret_cast<const uint8_t *>("\r\n"), 2); }
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long) {}
+    void end() {}
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t b) override;
+    using Print::write;
+    int availableForWrite() override { return SERIAL_TX_BUFFER_SIZE - 1; }
+    explicit operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// Bytes for `Serial.read`.
+extern const uint8_t *host_serial_input;
+extern size_t host_serial_input_size;
+
+#endif
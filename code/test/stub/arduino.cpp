@@ -0,0 +1,108 @@
+// Arduino stub for host tests
+// Adrian McCarthy 2022
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <stdio.h>
+
+unsigned long host_micros = 0;
+
+volatile uint8_t ADCSRA, ADCSRB, ADMUX, ADCH, DIDR0;
+volatile uint8_t UCSR0B, UCSR0C, UDR0;
+volatile uint8_t PORTD, DDRD;
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+namespace {
+
+uint32_t random_state = 1;
+
+long nextRandom() {
+  random_state = random_state * 1103515245u + 12345u;
+  return (random_state >> 8) & 0x7FFFFFFF;
+}
+
+volatile uint8_t ports[8];
+uint8_t eeprom[1024];
+
+}
+
+long random(long limit) { return limit > 0 ? nextRandom() % limit : 0; }
+long random(long low, long high) {
+  return low < high ? low + nextRandom() % (high - low) : low;
+}
+void randomSeed(unsigned long seed) { random_state = seed; }
+
+int analogRead(uint8_t) { return 512; }
+void pinMode(uint8_t, uint8_t) {}
+int digitalRead(uint8_t) { return LOW; }
+void digitalWrite(uint8_t, uint8_t) {}
+uint8_t digitalPinToBitMask(uint8_t pin) { return 1 << (pin & 7); }
+uint8_t digitalPinToPort(uint8_t pin) { return pin / 8; }
+volatile uint8_t *portOutputRegister(uint8_t port) { return &ports[port & 7]; }
+volatile uint8_t *portInputRegister(uint8_t port) { return &ports[port & 7]; }
+volatile uint8_t *portModeRegister(uint8_t port) { return &ports[port & 7]; }
+int digitalPinToInterrupt(uint8_t pin) { return pin == 2 ? 0 : pin == 3 ? 1 : -1; }
+void attachInterrupt(int, void (*)(), int) {}
+void detachInterrupt(int) {}
+
+uint8_t eeprom_read_byte(const uint8_t *address) {
+  return eeprom[reinterpret_cast<uintptr_t>(address) & 1023];
+}
+void eeprom_write_byte(uint8_t *address, uint8_t value) {
+  eeprom[reinterpret_cast<uintptr_t>(address) & 1023] = value;
+}
+void eeprom_update_byte(uint8_t *address, uint8_t value) {
+  eeprom_write_byte(address, value);
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::print(const __FlashStringHelper *s) {
+  return print(reinterpret_cast<const char *>(s));
+}
+size_t Print::print(const char *s) { return write(s); }
+size_t Print::print(char c) { return write(static_cast<uint8_t>(c)); }
+
+size_t Print::print(long n, int base) {
+  if (base == DEC) {
+    char text[16];
+    snprintf(text, sizeof(text), "%ld", n);
+    return write(text);
+  }
+  return print(static_cast<unsigned long>(n), base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  char text[16];
+  snprintf(text, sizeof(text), base == HEX ? "%lX" : "%lu", n);
+  return write(text);
+}
+
+size_t Print::print(double x, int digits) {
+  char text[32];
+  snprintf(text, sizeof(text), "%.*f", digits, x);
+  return write(text);
+}
+
+const uint8_t *host_serial_input = nullptr;
+size_t host_serial_input_size = 0;
+
+int HardwareSerial::available() { return static_cast<int>(host_serial_input_size); }
+int HardwareSerial::read() {
+  if (host_serial_input_size == 0) return -1;
+  --host_serial_input_size;
+  return *host_serial_input++;
+}
+int HardwareSerial::peek() {
+  return host_serial_input_size ? *host_serial_input : -1;
+}
+size_t HardwareSerial::write(uint8_t b) { return fputc(b, stdout) == EOF ? 0 : 1; }
+
+HardwareSerial Serial;
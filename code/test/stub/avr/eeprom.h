@@ -0,0 +1,13 @@
+#ifndef EEPROM_STUB_H
+#define EEPROM_STUB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The EEPROM is 1 KB of RAM, always ready.
+uint8_t eeprom_read_byte(const uint8_t *address);
+void eeprom_write_byte(uint8_t *address, uint8_t value);
+void eeprom_update_byte(uint8_t *address, uint8_t value);
+inline bool eeprom_is_ready() { return true; }
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef IO_STUB_H
+#define IO_STUB_H
+
+#include <stdint.h>
+
+// The registers the headers under test touch, as plain variables.
+extern volatile uint8_t ADCSRA, ADCSRB, ADMUX, ADCH, DIDR0;
+extern volatile uint8_t UCSR0B, UCSR0C, UDR0;
+extern volatile uint8_t PORTD, DDRD;
+
+enum { ADEN = 7, ADSC = 6, ADATE = 5, ADIF = 4, ADIE = 3,
+       ADPS2 = 2, ADPS1 = 1, ADPS0 = 0, REFS0 = 6, ADLAR = 5 };
+enum { UMSEL01 = 7, UMSEL00 = 6, TXEN0 = 3, TXCIE0 = 6 };
+enum { PORTD1 = 1, DDD1 = 1, PD4 = 4 };
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef PGMSPACE_STUB_H
+#define PGMSPACE_STUB_H
+
+#include <string.h>
+
+// On the host, program memory is just memory.
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*reinterpret_cast<const uint8_t *>(p))
+#define pgm_read_word(p) (*reinterpret_cast<const uint16_t *>(p))
+#define pgm_read_dword(p) (*reinterpret_cast<const uint32_t *>(p))
+#define pgm_read_ptr(p) (*reinterpret_cast<void *const *>(p))
+#define memcpy_P memcpy
+#define strcmp_P strcmp
+#define strlen_P strlen
+
+#endif
@@ -0,0 +1,399 @@
+// Sync bus test
+// Adrian McCarthy 2022
+
+// Runs a leader and several followers (see syncbus.h) on the host and
+// checks that the followers stay in step.  Each unit has its own fan
+// speed and its own clock, and it renders real animations with its own
+// Animator and times a cue with its own CueWheel.  The leader's serial
+// transmitter is modeled as the 63-byte buffer and a shift register that
+// sends a byte every 10 bit times into a pipe for each follower, which
+// feeds the bytes it reads to SyncBus::receive and SyncBus::follow.
+//
+// Time is simulated, so the results are the same on every run.
+
+#include <Arduino.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+#include "animator.h"
+#include "cuewheel.h"
+#include "patternbuffer.h"
+#include "rng.h"
+#include "syncbus.h"
+
+namespace {
+
+constexpr long BAUD = 9600;
+constexpr unsigned long STEP = 100;                 // us
+constexpr unsigned long FAN_PERIOD = 20000;         // us, 3000 RPM
+constexpr unsigned long EFFECT_START = 500000;      // us
+constexpr unsigned long EFFECT_LENGTH = 5000000;    // us
+constexpr unsigned long FOLLOWER_TIMEOUT = 2000;    // ms, as in the sketch
+constexpr unsigned long CUE_OFFSET = 3000;          // ms into the effect
+constexpr uint8_t TX_BUFFER = SERIAL_TX_BUFFER_SIZE - 1;
+
+// Animations that keep their state in the AnimationState, so that
+// several units can run them side by side.
+const Animation animations[] = { Glitch, RadialSeeds, Spokes, Pulse, Marquee };
+constexpr uint8_t ANIMATION_COUNT = sizeof(animations) / sizeof(animations[0]);
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+  if (condition) return;
+  printf("FAILED: %s\n", what);
+  ++failures;
+}
+
+uint16_t patternCRC(PatternBuffer &pattern) {
+  uint16_t crc = 0xFFFF;
+  for (uint8_t k = 0; k < pattern.size() / 8; ++k) {
+    crc ^= static_cast<uint16_t>(pattern.displayedByte(k)) << 8;
+    for (uint8_t i = 0; i < 8; ++i) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// The leader's serial transmitter.
+class Transmitter {
+  public:
+    Transmitter(unsigned noise_per_mille) :
+      m_noise(noise_per_mille), m_sending(false), m_done(0), m_stalls(0) {}
+
+    void connect(int fd) { m_sinks.push_back(fd); }
+
+    int availableForWrite() const {
+      return m_buffer.size() < TX_BUFFER ? TX_BUFFER - m_buffer.size() : 0;
+    }
+
+    // Serial.write would wait for room.  Here, the byte goes in anyway
+    // and the stall is counted.
+    size_t write(uint8_t b) {
+      if (m_buffer.size() >= TX_BUFFER) ++m_stalls;
+      m_buffer.push_back(b);
+      return 1;
+    }
+
+    void update() {
+      if (m_sending && host_micros >= m_done) {
+        m_sending = false;
+        uint8_t b = m_byte;
+        if (static_cast<unsigned>(random(1000)) < m_noise) b ^= 1 << random(8);
+        for (const auto fd : m_sinks) check(::write(fd, &b, 1) == 1, "pipe write");
+      }
+      if (!m_sending && !m_buffer.empty()) {
+        // Back to back, unless the line was idle.
+        const auto start = (m_done + STEP > host_micros) ? m_done : host_micros;
+        m_byte = m_buffer.front();
+        m_buffer.pop_front();
+        m_done = start + 10000000ul / BAUD;
+        m_sending = true;
+      }
+    }
+
+    unsigned stalls() const { return m_stalls; }
+
+  private:
+    std::deque<uint8_t> m_buffer;
+    std::vector<int> m_sinks;
+    unsigned m_noise;
+    bool m_sending;
+    uint8_t m_byte;
+    unsigned long m_done;
+    unsigned m_stalls;
+};
+
+// A tunnel, minus the hardware.  Also the `Effect` for SyncBus::follow.
+class Unit {
+  public:
+    Unit(unsigned long fan_period, double clock_rate) :
+      m_fan_period(fan_period), m_clock_rate(clock_rate),
+      m_next_rev(fan_period), m_rev_flag(false), m_running(false),
+      m_animation(0), m_seed(0), m_start(0), m_cue_time(0) {}
+
+    // This unit's idea of the time, from its own crystal.
+    unsigned long millis() const {
+      return static_cast<unsigned long>(host_micros * m_clock_rate / 1000.0);
+    }
+
+    // Returns true if it rendered a frame.
+    bool update() {
+      if (host_micros >= m_next_rev) {
+        m_next_rev += m_fan_period;
+        m_rev_flag = true;
+      }
+      Cue cue;
+      while (m_cues.poll(millis(), cue)) {
+        if (cue.action == CUE_FOG_ON) m_cue_time = host_micros;
+      }
+      if (!m_running) return false;
+      // The animations draw from the global Rng.
+      std::swap(rng, m_rng);
+      const bool rendered = m_animator.update(m_rev_flag, m_pattern);
+      std::swap(rng, m_rng);
+      return rendered;
+    }
+
+    uint16_t crc() { return patternCRC(m_pattern); }
+    unsigned long cueTime() const { return m_cue_time; }
+
+    bool running() const { return m_running; }
+    uint8_t animation() const { return m_animation; }
+    uint16_t seed() const { return m_seed; }
+    unsigned long start() const { return m_start; }
+    unsigned frame() const { return m_animator.frame(); }
+
+    void begin(uint8_t animation, uint16_t seed, unsigned long elapsed) {
+      m_running = true;
+      m_animation = animation;
+      m_seed = seed;
+      m_rng.seed(seed);
+      m_animator.setAnimation(animations[animation % ANIMATION_COUNT]);
+      m_start = millis() - elapsed;
+      m_cues.start(m_start);
+      m_cues.schedule(CUE_OFFSET, CUE_FOG_ON);
+      m_cue_time = 0;
+    }
+
+    void end() {
+      m_running = false;
+      m_cues.clear();
+      m_animator.setAnimation(nullptr);
+    }
+
+    void shift(long error) {
+      m_start -= error;
+      m_cues.shift(error);
+    }
+
+    void nudge(int frames) { m_animator.nudge(frames); }
+
+  private:
+    unsigned long m_fan_period;
+    double m_clock_rate;
+    unsigned long m_next_rev;
+    volatile bool m_rev_flag;
+    bool m_running;
+    uint8_t m_animation;
+    uint16_t m_seed;
+    unsigned long m_start;
+    unsigned long m_cue_time;
+    Rng m_rng;
+    Animator m_animator;
+    PatternBuffer m_pattern;
+    CueWheel<8> m_cues;
+};
+
+class Leader : public Unit {
+  public:
+    Leader(Transmitter &tx) :
+      Unit(FAN_PERIOD, 1.0), m_tx(tx), m_bus(SyncBus::LEADER, BAUD),
+      m_frames(0), m_beats(0), m_skipped(0), m_stalls(0), m_end_time(0) {}
+
+    void update() {
+      if (!running() && m_end_time == 0 && host_micros >= EFFECT_START) {
+        begin(2, 0x1234, 0);
+        sendBeat();
+      } else if (running() && host_micros >= EFFECT_START + EFFECT_LENGTH) {
+        end();
+        sendBeat();
+        m_end_time = host_micros;
+      }
+      if (!Unit::update()) return;
+      ++m_frames;
+      m_crcs[frame()] = crc();
+      // Now and then the console fills the buffer just before a beat,
+      // and in between it prints a shorter line.
+      if (frame() % 80 == 0) chatter(TX_BUFFER - 1);
+      if (frame() % 20 == 12) chatter(36);
+      if (frame() % SyncBus::BEAT_FRAMES == 0) sendBeat();
+    }
+
+    // The CRC of the leader's pattern after `frame - 1`, if it has one.
+    bool crcAt(unsigned frame, uint16_t &crc) const {
+      const auto it = m_crcs.find(frame);
+      if (it == m_crcs.end()) return false;
+      crc = it->second;
+      return true;
+    }
+
+    unsigned long endTime() const { return m_end_time; }
+    unsigned frames() const { return m_frames; }
+    unsigned beats() const { return m_beats; }
+    unsigned skipped() const { return m_skipped; }
+    unsigned stalls() const { return m_stalls; }
+
+  private:
+    void sendBeat() {
+      const SyncBus::Beat beat = {
+        running(), animation(), seed(), static_cast<uint16_t>(frame()),
+        millis() - start()
+      };
+      const auto stalls = m_tx.stalls();
+      if (m_bus.send(m_tx, beat)) ++m_beats; else ++m_skipped;
+      if (running()) m_stalls += m_tx.stalls() - stalls;
+    }
+
+    // Like the console, it prints only what fits.
+    void chatter(uint8_t length) {
+      if (m_tx.availableForWrite() < length) return;
+      for (uint8_t i = 0; i < length; ++i) m_tx.write(i + 1 < length ? 'x' : '\n');
+    }
+
+    Transmitter &m_tx;
+    SyncBus m_bus;
+    std::map<unsigned, uint16_t> m_crcs;
+    unsigned m_frames;
+    unsigned m_beats;
+    unsigned m_skipped;
+    unsigned m_stalls;
+    unsigned long m_end_time;
+};
+
+class Follower : public Unit {
+  public:
+    Follower(unsigned long fan_period, double clock_rate, int fd,
+             unsigned long listen_at) :
+      Unit(fan_period, clock_rate), m_bus(SyncBus::FOLLOWER, BAUD), m_fd(fd),
+      m_listen_at(listen_at), m_last_beat(0), m_beats(0), m_caught_up(false),
+      m_worst_frame(0), m_worst_time(0), m_compared(0), m_mismatches(0),
+      m_end_time(0) {}
+
+    ~Follower() { close(m_fd); }
+
+    void update(const Leader &leader) {
+      uint8_t buffer[64];
+      const auto count = read(m_fd, buffer, sizeof(buffer));
+      for (ssize_t i = 0; i < count && host_micros >= m_listen_at; ++i) {
+        if (m_bus.receive(buffer[i]) != SyncBus::READY) continue;
+        ++m_beats;
+        m_last_beat = millis();
+        m_bus.follow(*this, millis());
+      }
+      // The leader decides when the effect ends, unless it's gone quiet.
+      if (running() && millis() - m_last_beat > FOLLOWER_TIMEOUT) end();
+      if (!running() && m_end_time == 0 && leader.endTime() != 0) {
+        m_end_time = host_micros;
+      }
+
+      if (!Unit::update() || !leader.running()) return;
+      uint16_t expected;
+      if (leader.crcAt(frame(), expected)) {
+        ++m_compared;
+        if (crc() != expected) ++m_mismatches;
+      }
+      const int frame_error = frame() - leader.frame();
+      const long time_error = (millis() - start()) - (leader.millis() - leader.start());
+      if (!m_caught_up) {
+        m_caught_up = abs(frame_error) <= 1;
+        if (!m_caught_up) return;
+      }
+      if (abs(frame_error) > m_worst_frame) m_worst_frame = abs(frame_error);
+      if (labs(time_error) > m_worst_time) m_worst_time = labs(time_error);
+    }
+
+    unsigned beats() const { return m_beats; }
+    bool caughtUp() const { return m_caught_up; }
+    int worstFrame() const { return m_worst_frame; }
+    long worstTime() const { return m_worst_time; }
+    unsigned compared() const { return m_compared; }
+    unsigned mismatches() const { return m_mismatches; }
+    unsigned long endTime() const { return m_end_time; }
+
+  private:
+    SyncBus m_bus;
+    int m_fd;
+    unsigned long m_listen_at;
+    unsigned long m_last_beat;
+    unsigned m_beats;
+    bool m_caught_up;
+    int m_worst_frame;
+    long m_worst_time;
+    unsigned m_compared;
+    unsigned m_mismatches;
+    unsigned long m_end_time;
+};
+
+struct FollowerSpec {
+  double fan_drift;   // fraction
+  double clock_rate;
+  unsigned long listen_at;  // us
+};
+
+// With `noise_per_mille` of the bytes on the wire corrupted, a lost
+// end beat may leave a follower running until it times out.
+void run(const char *name, unsigned noise_per_mille) {
+  printf("%s:\n", name);
+  const FollowerSpec specs[] = {
+    {  0.02, 1.000,  0 },
+    { -0.02, 1.005,  0 },
+    {  0.01, 0.995,  EFFECT_START + 1000000 }
+  };
+  host_micros = 0;
+  randomSeed(1);
+  Transmitter tx(noise_per_mille);
+  Leader leader(tx);
+  std::vector<Follower *> followers;
+  std::vector<int> wires;
+  for (const auto &spec : specs) {
+    int fds[2];
+    check(pipe(fds) == 0, "pipe");
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    tx.connect(fds[1]);
+    wires.push_back(fds[1]);
+    followers.push_back(new Follower(FAN_PERIOD * (1 + spec.fan_drift),
+                                     spec.clock_rate, fds[0], spec.listen_at));
+  }
+
+  const auto finish = EFFECT_START + EFFECT_LENGTH + (FOLLOWER_TIMEOUT + 500) * 1000;
+  for (; host_micros < finish; host_micros += STEP) {
+    tx.update();
+    leader.update();
+    for (auto f : followers) f->update(leader);
+  }
+
+  printf("  leader: %u frames, %u beats, %u skipped for a full buffer\n",
+         leader.frames(), leader.beats(), leader.skipped());
+  check(leader.skipped() > 0, "a beat was skipped for a full buffer");
+  check(leader.stalls() == 0, "beats never wait for room while animating");
+  // A follower's frames come from its own fan, so it can be a
+  // revolution off, plus what it drifts between beats.
+  constexpr int FRAME_TOLERANCE = 2;
+  // The beat's times are in whole ms, and the follower's clock drifts
+  // a little between beats.
+  constexpr long TIME_TOLERANCE = 4;
+  for (auto f : followers) {
+    const long cue_error =
+      (static_cast<long>(f->cueTime()) - static_cast<long>(leader.cueTime())) / 1000;
+    const long end_delay = (f->endTime() - leader.endTime()) / 1000;
+    printf("  follower: %u beats, frame error %d, time error %ld ms, "
+           "cue error %ld ms, %u/%u frames match, ended after %ld ms\n",
+           f->beats(), f->worstFrame(), f->worstTime(), cue_error,
+           f->compared() - f->mismatches(), f->compared(), end_delay);
+    check(f->caughtUp(), "follower caught up");
+    check(f->worstFrame() <= FRAME_TOLERANCE, "frame error");
+    check(f->worstTime() <= TIME_TOLERANCE, "effect time error");
+    check(f->cueTime() != 0 && labs(cue_error) <= CueWheel<8>::TICK_MS + TIME_TOLERANCE,
+          "cue time");
+    check(f->compared() > 0 && f->mismatches() == 0, "frames match the leader's");
+    check(!f->running(), "follower ended the effect");
+    if (noise_per_mille == 0) check(end_delay < 50, "follower ended with the leader");
+    delete f;
+  }
+  for (const auto fd : wires) close(fd);
+}
+
+}
+
+int main() {
+  run("clean wire", 0);
+  run("noisy wire", 5);
+  printf(failures ? "Sync bus test FAILED\n" : "Sync bus test passed\n");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+# Laser Tunnel memory footprint report
+# Adrian McCarthy 2022
+
+"""Breaks down the RAM and flash used by a build, symbol by symbol.
+
+The Arduino IDE doesn't have a post-build hook, so build with
+arduino-cli and keep the output, then run this on the ELF file:
+
+    arduino-cli compile -b arduino:avr:pro --output-dir build laser_tunnel
+    python3 footprint.py build/laser_tunnel.ino.elf
+
+By default, symbols are grouped by class (everything before the last
+`::`), which makes it easy to compare, say, DebugAudioEventHandler and
+AudioEventHandler, including their vtables.  Use --symbols to list
+individual symbols, and --match to filter by a regular expression.
+
+Flash includes code, PROGMEM data, and the initial values of .data.
+RAM includes .data and .bss.  avr-gcc puts vtables and other read-only
+data in .data, so they take both.  Symbols are sorted into flash and
+RAM by address rather than by nm's type letter, which doesn't say where
+a weak object (such as a header-only class's vtable) lives.  The stack
+and the heap aren't symbols, so they aren't counted here; use the `mem`
+console command at runtime.
+"""
+
+import argparse
+import collections
+import re
+import subprocess
+import sys
+
+RAM_SIZE = 2048
+FLASH_SIZE = 32768 - 2048   # less the bootloader
+
+# avr-gcc links RAM at 0x800000 and EEPROM at 0x810000, so that the
+# address spaces don't overlap.  In RAM, .data comes first and ends at
+# __data_end.  Initialized data takes flash for its initial value and
+# RAM for the variable.
+RAM_START = 0x800000
+EEPROM_START = 0x810000
+
+PREFIXES = ('vtable for ', 'typeinfo for ', 'typeinfo name for ',
+            'non-virtual thunk to ', 'construction vtable for ')
+
+
+def read_symbols(nm, elf):
+    """Returns a list of (name, address, size) and a dict of the
+    addresses of the symbols without a size, such as __data_end."""
+    try:
+        output = subprocess.run(
+            [nm, '--demangle', '--print-size', '--radix=d', elf],
+            check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    except (OSError, subprocess.CalledProcessError) as e:
+        sys.exit('%s: %s' % (nm, e))
+    symbols = []
+    markers = {}
+    for line in output.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) < 3 or not parts[0].isdigit():
+            continue
+        if parts[1].isdigit() and len(parts) == 4:
+            address, size, _, name = parts
+            symbols.append((name, int(address), int(size)))
+        else:
+            markers[parts[-1]] = int(parts[0])
+    return symbols, markers
+
+
+def group_name(symbol):
+    for prefix in PREFIXES:
+        if symbol.startswith(prefix):
+            symbol = symbol[len(prefix):]
+            return symbol
+    # Drop the parameter list so that `::` in parameter types doesn't
+    # confuse things.
+    base = symbol.split('(', 1)[0]
+    scope, sep, _ = base.rpartition('::')
+    return scope if sep else '(global) ' + base
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('elf')
+    parser.add_argument('--nm', default='avr-nm')
+    parser.add_argument('--symbols', action='store_true',
+                        help='list symbols instead of classes')
+    parser.add_argument('--match', help='regular expression to filter by')
+    parser.add_argument('--top', type=int, default=0,
+                        help='show only the N biggest')
+    args = parser.parse_args()
+
+    flash = collections.Counter()
+    ram = collections.Counter()
+    total_flash = total_ram = 0
+    symbols, markers = read_symbols(args.nm, args.elf)
+    data_end = markers.get('__data_end')
+    if data_end is None:
+        sys.exit('%s: no __data_end symbol' % args.elf)
+    for name, address, size in symbols:
+        if address >= EEPROM_START:
+            continue
+        key = name if args.symbols else group_name(name)
+        if args.match and not re.search(args.match, key):
+            continue
+        if address < RAM_START or address < data_end:
+            flash[key] += size
+            total_flash += size
+        if address >= RAM_START:
+            ram[key] += size
+            total_ram += size
+
+    keys = sorted(set(flash) | set(ram),
+                  key=lambda k: (ram[k], flash[k]), reverse=True)
+    if args.top:
+        keys = keys[:args.top]
+    print('%6s %6s  %s' % ('RAM', 'flash', 'symbol' if args.symbols else 'class'))
+    for key in keys:
+        print('%6d %6d  %s' % (ram[key], flash[key], key))
+    print('%6d %6d  total (%d%% of RAM, %d%% of flash)' %
+          (total_ram, total_flash, 100 * total_ram // RAM_SIZE,
+           100 * total_flash // FLASH_SIZE))
+
+
+if __name__ == '__main__':
+    main()
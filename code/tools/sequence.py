@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+# Laser Tunnel sequence compiler
+# Adrian McCarthy 2022
+
+"""Converts a frame sequence into the delta-compressed PROGMEM array
+played by SequencePlayer (see laser_tunnel/sequence.h).
+
+The Arduino IDE doesn't have a pre-build hook, so run this whenever a
+sequence changes and commit the generated header along with it:
+
+    python3 sequence.py sequences/*.txt -o ../laser_tunnel/sequences.h
+
+Each input file becomes one array named after the file.  Inputs can be:
+
+* Text (.txt):  one frame per line.  A line lists the lit pixels as
+  indexes or inclusive ranges, like `0-7 32-39 200`.  A line with just
+  `-` is an empty frame.  `hold N` repeats the previous frame N more
+  times.  Everything after a `#` is a comment.
+
+* Image strips (.png, .gif, etc., requires Pillow):  each row of the
+  image is a frame.  The row is resampled to 256 pixels, and pixels
+  brighter than 50% are lit.
+"""
+
+import argparse
+import os
+import sys
+
+PIXELS = 256
+BYTES = PIXELS // 8
+
+SKIP, LITERAL, RUN, HOLD, END = 0x00, 0x40, 0x80, 0xC0, 0xFF
+MAX_COUNT = 64       # for skip, literal, and run tokens
+MAX_HOLD = 63        # 0xFF is reserved for END
+
+
+def frame_from_pixels(lit):
+    frame = bytearray(BYTES)
+    for i in lit:
+        i %= PIXELS
+        frame[i // 8] |= 0x80 >> (i % 8)
+    return bytes(frame)
+
+
+def parse_text(lines, path):
+    """Yields the frames described by lines of text, as they're read."""
+    previous = None
+    for lineno, line in enumerate(lines, 1):
+        line = line.split('#', 1)[0].strip()
+        if not line:
+            continue
+        words = line.split()
+        if words[0] == 'hold':
+            if previous is None or len(words) != 2:
+                sys.exit('%s(%d): bad hold' % (path, lineno))
+            for _ in range(int(words[1])):
+                yield previous
+            continue
+        lit = []
+        for word in words:
+            if word == '-':
+                continue
+            first, _, last = word.partition('-')
+            last = last or first
+            lit.extend(range(int(first), int(last) + 1))
+        previous = frame_from_pixels(lit)
+        yield previous
+
+
+def read_text(path):
+    with open(path) as f:
+        return list(parse_text(f, path))
+
+
+def read_image(path):
+    try:
+        from PIL import Image
+    except ImportError:
+        sys.exit('%s: reading images requires Pillow' % path)
+    image = Image.open(path).convert('L')
+    image = image.resize((PIXELS, image.height), Image.NEAREST)
+    frames = []
+    for y in range(image.height):
+        lit = [x for x in range(PIXELS) if image.getpixel((x, y)) >= 128]
+        frames.append(frame_from_pixels(lit))
+    return frames
+
+
+def encode_delta(delta):
+    out = []
+    k = 0
+    while k < BYTES:
+        if delta[k] == 0:
+            n = 1
+            while k + n < BYTES and delta[k + n] == 0 and n < MAX_COUNT:
+                n += 1
+            out.append(SKIP | (n - 1))
+            k += n
+            continue
+        n = 1
+        while k + n < BYTES and delta[k + n] == delta[k] and n < MAX_COUNT:
+            n += 1
+        if n >= 3:
+            out.extend([RUN | (n - 1), delta[k]])
+            k += n
+            continue
+        # Gather literals until a stretch that would encode better
+        # as a skip or a run.
+        start = k
+        while k < BYTES and k - start < MAX_COUNT:
+            if delta[k] == 0 and (k + 1 == BYTES or delta[k + 1] == 0):
+                break
+            if k + 2 < BYTES and delta[k] == delta[k + 1] == delta[k + 2]:
+                break
+            k += 1
+        if k == start:
+            k += 1
+        out.append(LITERAL | (k - start - 1))
+        out.extend(delta[start:k])
+    return out
+
+
+def encode(frames):
+    out = []
+    previous = bytes(BYTES)
+    held = 0
+    for frame in frames:
+        if out and frame == previous:
+            held += 1
+            continue
+        while held > 0:
+            n = min(held, MAX_HOLD)
+            out.append(HOLD | (n - 1))
+            held -= n
+        out.extend(encode_delta([a ^ b for a, b in zip(previous, frame)]))
+        previous = frame
+    while held > 0:
+        n = min(held, MAX_HOLD)
+        out.append(HOLD | (n - 1))
+        held -= n
+    out.append(END)
+    return out
+
+
+def decode(data):
+    """Mirrors SequencePlayer::render, for checking the encoder."""
+    frames = []
+    frame = bytearray(BYTES)
+    i = 0
+    while data[i] != END:
+        token = data[i]
+        i += 1
+        n = (token & 0x3F) + 1
+        if token & 0xC0 == HOLD:
+            frames.extend([bytes(frame)] * n)
+            continue
+        k = 0
+        while True:
+            if token & 0xC0 == SKIP:
+                k += n
+            elif token & 0xC0 == LITERAL:
+                for j in range(n):
+                    frame[k + j] ^= data[i + j]
+                i += n
+                k += n
+            else:
+                for j in range(n):
+                    frame[k + j] ^= data[i]
+                i += 1
+                k += n
+            if k >= BYTES:
+                break
+            token = data[i]
+            i += 1
+            n = (token & 0x3F) + 1
+        frames.append(bytes(frame))
+    return frames
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('inputs', nargs='+')
+    parser.add_argument('-o', '--output', default='-')
+    args = parser.parse_args()
+
+    lines = [
+        '// Generated by code/tools/sequence.py.  Do not edit.',
+        '',
+        '#ifndef SEQUENCES_H',
+        '#define SEQUENCES_H',
+        '',
+        '#include <avr/pgmspace.h>',
+        '',
+    ]
+    for path in args.inputs:
+        name, ext = os.path.splitext(os.path.basename(path))
+        frames = read_text(path) if ext == '.txt' else read_image(path)
+        if not frames:
+            sys.exit('%s: no frames' % path)
+        data = encode(frames)
+        assert decode(data) == frames
+        lines.append('// %s: %d frames in %d bytes (%d uncompressed)' %
+                     (os.path.basename(path), len(frames), len(data),
+                      len(frames) * BYTES))
+        lines.append('const uint8_t %s_sequence[] PROGMEM = {' % name)
+        for i in range(0, len(data), 12):
+            chunk = data[i:i + 12]
+            lines.append('  ' + ', '.join('0x%02X' % b for b in chunk) + ',')
+        lines.append('};')
+        lines.append('')
+    lines.append('#endif')
+
+    text = '\n'.join(lines) + '\n'
+    if args.output == '-':
+        sys.stdout.write(text)
+    else:
+        with open(args.output, 'w') as f:
+            f.write(text)
+
+
+if __name__ == '__main__':
+    main()
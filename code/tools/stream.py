@@ -0,0 +1,244 @@
+#!/usr/bin/env python3
+# Laser Tunnel frame streamer
+# Adrian McCarthy 2022
+
+"""Streams frames to a laser tunnel over its serial port (see
+laser_tunnel/framestream.h).
+
+    python3 stream.py /dev/ttyUSB0 sequences/spokes.txt --loop
+    my_generator | python3 stream.py /dev/ttyUSB0 -
+
+Inputs are in the formats that sequence.py reads.  With `-`, frames
+are read as lines of text from stdin and sent as they arrive.
+
+The first frame is sent whole, and the rest are sent as deltas from
+the previous frame.  The streamer waits for the tunnel's '>' before
+sending each frame after the first.  If the tunnel reports a bad frame
+('!') or stops answering, the streamer sends a whole frame next.
+
+To try it without hardware, use `--pty`.  That runs a model of the
+tunnel's receiver on one side of a pseudo-terminal and streams to the
+other side, then checks that every frame shown matches one sent.
+"""
+
+import argparse
+import os
+import select
+import sys
+import termios
+import threading
+import time
+import tty
+
+import sequence
+
+KEY, DELTA = ord('F'), ord('D')
+READY, CORRUPTED = ord('>'), ord('!')
+
+
+def key_message(frame):
+    return bytes([ord('#'), KEY]) + frame + bytes([sum(frame) & 0xFF])
+
+
+def delta_message(previous, frame):
+    tokens = sequence.encode_delta([a ^ b for a, b in zip(previous, frame)])
+    return bytes([ord('#'), DELTA] + tokens + [sum(tokens) & 0xFF])
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        speed = getattr(termios, 'B%d' % baud)
+        attrs[4] = attrs[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+class Streamer:
+    def __init__(self, fd, timeout):
+        self.fd = fd
+        self.timeout = timeout
+        self.previous = None
+        self.credit = 1
+        self.sent = 0
+        self.keys = 0
+        self.stalls = 0
+
+    def wait_for_credit(self):
+        deadline = time.monotonic() + self.timeout
+        while self.credit == 0:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                # Lost a frame or a reply.  Start over with a key frame.
+                self.stalls += 1
+                self.previous = None
+                self.credit = 1
+                return
+            ready, _, _ = select.select([self.fd], [], [], remaining)
+            if not ready:
+                continue
+            for b in os.read(self.fd, 256):
+                if b == READY:
+                    self.credit = 1
+                elif b == CORRUPTED:
+                    self.previous = None
+                # Anything else is console chatter.
+
+    def send(self, frame):
+        self.wait_for_credit()
+        if self.previous is None:
+            message = key_message(frame)
+            self.keys += 1
+        else:
+            message = delta_message(self.previous, frame)
+        os.write(self.fd, message)
+        self.previous = frame
+        self.credit = 0
+        self.sent += 1
+
+
+class FakeTunnel(threading.Thread):
+    """Models FrameStream, presenting at most one frame per revolution."""
+
+    def __init__(self, fd, revolution):
+        super().__init__(daemon=True)
+        self.fd = fd
+        self.revolution = revolution
+        self.back = bytearray(sequence.BYTES)
+        self.pending = False
+        self.shown = []
+        self.dropped = 0
+        self.corrupted = 0
+        self.done = False
+
+    def read(self):
+        while True:
+            data = os.read(self.fd, 1)
+            if data:
+                return data[0]
+
+    def receive(self):
+        while self.read() != ord('#'):
+            pass
+        kind = self.read()
+        if kind not in (KEY, DELTA):
+            return
+        if self.pending:
+            self.dropped += 1
+            self.pending = False
+        total = 0
+        k = 0
+        while k < sequence.BYTES:
+            if kind == KEY:
+                b = self.read()
+                total += b
+                self.back[k] = b
+                k += 1
+                continue
+            token = self.read()
+            total += token
+            n = (token & 0x3F) + 1
+            op = token & 0xC0
+            if op == sequence.SKIP:
+                k += n
+                continue
+            if op == sequence.LITERAL:
+                for _ in range(n):
+                    b = self.read()
+                    total += b
+                    self.back[k] ^= b
+                    k += 1
+            else:
+                b = self.read()
+                total += b
+                for _ in range(n):
+                    self.back[k] ^= b
+                    k += 1
+        if self.read() != total & 0xFF:
+            self.corrupted += 1
+            os.write(self.fd, bytes([CORRUPTED]))
+            return
+        self.pending = True
+
+    def present(self):
+        while not self.done:
+            time.sleep(self.revolution)
+            if self.pending:
+                self.pending = False
+                self.shown.append(bytes(self.back))
+                os.write(self.fd, bytes([READY]))
+
+    def run(self):
+        threading.Thread(target=self.present, daemon=True).start()
+        while True:
+            self.receive()
+
+
+def frames_from(inputs, loop):
+    while True:
+        for path in inputs:
+            if path == '-':
+                yield from sequence.parse_text(sys.stdin, '<stdin>')
+                return
+            name, ext = os.path.splitext(path)
+            if ext == '.txt':
+                yield from sequence.read_text(path)
+            else:
+                yield from sequence.read_image(path)
+        if not loop:
+            return
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('port', nargs='?',
+                        help='serial port (omit with --pty)')
+    parser.add_argument('inputs', nargs='+')
+    parser.add_argument('-b', '--baud', type=int, default=9600)
+    parser.add_argument('--loop', action='store_true',
+                        help='repeat the inputs until interrupted')
+    parser.add_argument('--timeout', type=float, default=0.5,
+                        help='seconds to wait for the tunnel to be ready')
+    parser.add_argument('--pty', action='store_true',
+                        help='stream to a simulated tunnel')
+    args = parser.parse_args()
+
+    tunnel = None
+    if args.pty:
+        if args.port is not None:
+            args.inputs.insert(0, args.port)
+        master, slave = os.openpty()
+        tty.setraw(master)
+        tunnel = FakeTunnel(master, revolution=0.02)
+        tunnel.start()
+        fd = open_port(os.ttyname(slave), args.baud)
+    elif args.port is None:
+        parser.error('a serial port is required')
+    else:
+        fd = open_port(args.port, args.baud)
+
+    streamer = Streamer(fd, args.timeout)
+    sent = []
+    try:
+        for frame in frames_from(args.inputs, args.loop):
+            streamer.send(frame)
+            sent.append(frame)
+    except KeyboardInterrupt:
+        pass
+
+    print('sent %d frames (%d whole), %d stalls' %
+          (streamer.sent, streamer.keys, streamer.stalls))
+    if tunnel is not None:
+        time.sleep(5 * tunnel.revolution)
+        tunnel.done = True
+        bad = [f for f in tunnel.shown if f not in sent]
+        print('tunnel showed %d, dropped %d, corrupted %d, mismatched %d' %
+              (len(tunnel.shown), tunnel.dropped, tunnel.corrupted, len(bad)))
+        if bad or len(tunnel.shown) != len(sent):
+            sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()